@@ -20,12 +20,16 @@
 #include <vector>
 #include <ctime>
 #include <chrono>
+#include <random>
+#include <algorithm>
 
 #include "vajolet.h"
 #include "search.h"
 #include "position.h"
 #include "transposition.h"
 #include "thread.h"
+#include "command.h"
+#include "perfcounters.h"
 
 static const std::vector<std::string>positions = {
   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
@@ -47,32 +51,295 @@ static const std::vector<std::string>positions = {
 };
 
 
-void benchmark(void)
+/*! \brief read the positions of a fen file, one fen per line. empty lines and lines starting with # are skipped*/
+static bool readFenFile(const std::string& fileName, std::vector<std::string>& fens)
 {
-	TT.setSize(32);
+	std::ifstream ifs(fileName);
+	if( !ifs.is_open() )
+	{
+		return false;
+	}
+	std::string line;
+	while( std::getline(ifs, line) )
+	{
+		const size_t first = line.find_first_not_of(" \t\r");
+		if( first == std::string::npos || line[first] == '#' )
+		{
+			continue;
+		}
+		const size_t last = line.find_last_not_of(" \t\r");
+		fens.push_back( line.substr(first, last - first + 1) );
+	}
+	return true;
+}
+
+static std::string jsonString(const std::string& s)
+{
+	std::string res = "\"";
+	for( auto c: s )
+	{
+		if( c == '"' || c == '\\' )
+		{
+			res += '\\';
+		}
+		res += c;
+	}
+	return res + "\"";
+}
 
+/*! \brief get the bench positions, the default ones or the ones of a fen file*/
+static bool getBenchPositions(const std::string& fenFile, std::vector<std::string>& fens)
+{
+	if( fenFile.empty() )
+	{
+		fens = positions;
+		return true;
+	}
+	if( !readFenFile(fenFile, fens) || fens.empty() )
+	{
+		sync_cout << "info string cannot read positions from " << fenFile << sync_endl;
+		return false;
+	}
+	return true;
+}
+
+struct benchResult
+{
 	unsigned long long nodes = 0;
+	long long int time = 0;
+	unsigned long long helperPositions = 0;
+	unsigned long long duplicated = 0;
+	unsigned long long evalCacheProbes = 0;
+	unsigned long long evalCacheHits = 0;
+};
 
-	long long int totalTime = Search::getTime();
+/*! \brief search every position to a fixed depth with the given number of threads
+	the hash table is resized (and cleared) before the first position, the info output of the search is disabled
+*/
+static benchResult runBench(const std::vector<std::string>& fens, unsigned int depth, unsigned int threads, unsigned int hashSize, bool printPositions)
+{
+	benchResult total;
+	perfCounters perf;
+	Search::threads = threads;
+	TT.setSize(hashSize, threads);
+	// only the JSON lines of the benchmark are printed
+	const bool previousSilentOutput = Search::silentOutput;
+	Search::silentOutput = true;
 
+	long long int totalTime = Search::getTime();
 
-	for (unsigned int i = 0; i < positions.size(); i++)
+	for (unsigned int i = 0; i < fens.size(); i++)
 	{
 		Search src;
-		src.limits.depth = 15;
+		src.limits.depth = depth;
 		src.resetStartTime();
 		src.resetPonderTime();
-		src.pos.setupFromFen(positions[i]);
-		sync_cout << "\nPosition: " << i + 1 << '/' << positions.size() << sync_endl;
-		src.startThinking();
-		nodes += src.getVisitedNodes();
+		src.pos.setupFromFen(fens[i]);
+		if( perfCounters::enabled )
+		{
+			perf.start();
+		}
+		long long int time = Search::getTime();
+		const startThinkResult res = src.startThinking();
+		time = Search::getTime() - time;
+		if( perfCounters::enabled )
+		{
+			perf.stop();
+		}
+		const unsigned long long positionNodes = src.getVisitedNodes();
+		total.nodes += positionNodes;
+
+		const duplicatedNodes dup = src.getDuplicatedNodes();
+		total.helperPositions += dup.helperPositions;
+		total.duplicated += dup.duplicated;
+
+		const evalCacheStats ecs = src.getEvalCacheStats();
+		total.evalCacheProbes += ecs.probes;
+		total.evalCacheHits += ecs.hits;
+
+		if( printPositions )
+		{
+			sync_cout << "{\"position\":" << i + 1
+					<< ",\"fen\":" << jsonString(fens[i])
+					<< ",\"depth\":" << res.depth
+					<< ",\"nodes\":" << positionNodes
+					<< ",\"time\":" << time
+					<< ",\"nps\":" << 1000 * positionNodes / ( time + 1 )
+					<< ",\"bestmove\":" << jsonString( res.PV.size() ? displayUci( res.PV.front() ) : "0000" )
+					<< ( perfCounters::enabled ? ",\"perf\":" + perf.toJson() : "" )
+					<< "}" << sync_endl;
+		}
+	}
+
+	total.time = Search::getTime() - totalTime + 1;
+	Search::silentOutput = previousSilentOutput;
+	if( perfCounters::enabled && !perf.isAvailable() )
+	{
+		sync_cout << perf.toInfoString() << sync_endl;
+	}
+	return total;
+}
+
+/*! \brief search a list of positions to a fixed depth
+	every position and the summary are printed as a JSON object on a single line.
+	with one thread the search is deterministic and the total node count is the signature of the search behaviour.
+	the hash table is resized for the run and then restored to its previous size (and cleared)
+*/
+void benchmark(unsigned int depth, unsigned int threads, unsigned int hashSize, const std::string& fenFile)
+{
+	std::vector<std::string> fens;
+	if( !getBenchPositions(fenFile, fens) )
+	{
+		return;
+	}
+
+	const unsigned long int previousHashSize = TT.getSizeMB();
+	const unsigned int previousThreads = Search::threads;
+
+	const benchResult res = runBench(fens, depth, threads, hashSize, true);
+
+	sync_cout << "{\"bench\":{\"positions\":" << fens.size()
+			<< ",\"depth\":" << depth
+			<< ",\"threads\":" << threads
+			<< ",\"hash\":" << hashSize
+			<< ",\"nodes\":" << res.nodes
+			<< ",\"time\":" << res.time
+			<< ",\"nps\":" << 1000 * res.nodes / res.time
+			<< ",\"evalCacheHitRate\":" << ( res.evalCacheProbes ? (double)res.evalCacheHits / res.evalCacheProbes : 0.0 )
+			<< ",\"signature\":" << ( threads == 1 ? std::to_string(res.nodes) : "null" )
+			<< "}}" << sync_endl;
+
+	Search::threads = previousThreads;
+	TT.setSize(previousHashSize, previousThreads);
+}
+
+/*! \brief lazy smp scaling: run the bench positions with 1, 2, 4 ... maxThreads threads
+	for every thread count prints the NPS speedup and the time to depth speedup over the single thread run,
+	and the fraction of the distinct positions searched by the helpers that the main thread searched too (null when the build
+	doesn't define ENABLE_VISITED_POSITIONS)
+*/
+void smpBenchmark(unsigned int depth, unsigned int maxThreads, unsigned int hashSize, const std::string& fenFile)
+{
+	std::vector<std::string> fens;
+	if( !getBenchPositions(fenFile, fens) )
+	{
+		return;
+	}
+
+	const unsigned long int previousHashSize = TT.getSizeMB();
+	const unsigned int previousThreads = Search::threads;
+	Search::recordVisitedPositions = true;
+
+	std::vector<unsigned int> threadCounts;
+	for( unsigned int t = 1; t < maxThreads; t *= 2 )
+	{
+		threadCounts.push_back(t);
+	}
+	threadCounts.push_back(maxThreads);
+
+	benchResult single;
+	for( auto threads: threadCounts )
+	{
+		const benchResult res = runBench(fens, depth, threads, hashSize, false);
+		if( threads == 1 )
+		{
+			single = res;
+		}
+		const double nps = 1000.0 * res.nodes / res.time;
+		const double singleNps = 1000.0 * single.nodes / single.time;
+
+		sync_cout << "{\"smp\":{\"threads\":" << threads
+				<< ",\"depth\":" << depth
+				<< ",\"hash\":" << hashSize
+				<< ",\"nodes\":" << res.nodes
+				<< ",\"time\":" << res.time
+				<< ",\"nps\":" << (unsigned long long)nps
+				<< ",\"npsSpeedup\":" << nps / singleNps
+				<< ",\"ttdSpeedup\":" << (double)single.time / res.time
+#ifdef ENABLE_VISITED_POSITIONS
+				<< ",\"duplicated\":" << ( res.helperPositions ? (double)res.duplicated / res.helperPositions : 0.0 )
+#else
+				<< ",\"duplicated\":null"
+#endif
+				<< "}}" << sync_endl;
+	}
+
+	Search::recordVisitedPositions = false;
+	Search::threads = previousThreads;
+	TT.setSize(previousHashSize, previousThreads);
+}
+
+
+void hashBenchmark(unsigned int mbSize)
+{
+	const unsigned int probes = 4000000;
+
+	std::vector<U64> keys(probes);
+	std::mt19937_64 rng(1);
+	for(auto& k: keys)
+	{
+		k = rng();
 	}
 
-	totalTime =Search::getTime() - totalTime + 1;
+	sync_cout << "\nHash benchmark (" << mbSize << "MB)" << sync_endl;
+
+	for(bool useHugePages: {false, true})
+	{
+		transpositionTable tt;
+		tt.setSize(mbSize, Search::threads, useHugePages);
+
+		// fill the table, so that every probe touches a random cache line
+		for(unsigned int i = 0; i < probes; i++)
+		{
+			tt.store(keys[i], 0, typeExact, 1, 1, 0);
+		}
+
+		unsigned long long hits = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(unsigned int i = 0; i < probes; i++)
+		{
+			hits += tt.probe(keys[probes - 1 - i]).getPackedMove();
+		}
+		auto end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (double)probes;
 
-	sync_cout << "\n==========================="
-       << "\nTotal time (ms) : " << totalTime
-       << "\nNodes searched  : " << nodes
-       << "\nNodes/second    : " << 1000 * nodes / totalTime << sync_endl;
+		sync_cout << "huge pages " << (useHugePages ? "requested" : "disabled ")
+				<< (tt.isUsingHugePages() ? " (obtained)    " : " (not obtained)")
+				<< " : " << ns << " ns/probe, hits " << hits << sync_endl;
+	}
+}
+
+/*! \brief run "go movetime" searches through the engine thread and measure how long it takes to send the bestmove
+	the summary with the overshoot distribution (in microseconds) is printed as a JSON object on a single line
+*/
+void timeBenchmark(unsigned int moveTime, unsigned int searches)
+{
+	my_thread* thr = my_thread::getInstance();
+	thr->waitSearchEnd();
+
+	Position pos;
+	pos.setupFromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10");
+
+	std::vector<long long int> overshoot;
+	for( unsigned int i = 0; i < searches; i++ )
+	{
+		searchLimits limits;
+		limits.moveTime = moveTime;
+
+		auto start = std::chrono::steady_clock::now();
+		thr->startThinking(&pos, limits);
+		thr->waitSearchEnd();
+		auto end = std::chrono::steady_clock::now();
+
+		overshoot.push_back( std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() - moveTime * 1000ll );
+	}
 
+	std::sort(overshoot.begin(), overshoot.end());
+	sync_cout << "{\"timebench\":{\"movetime\":" << moveTime
+			<< ",\"searches\":" << searches
+			<< ",\"min\":" << overshoot.front()
+			<< ",\"median\":" << overshoot[ searches / 2 ]
+			<< ",\"p90\":" << overshoot[ searches * 9 / 10 ]
+			<< ",\"max\":" << overshoot.back()
+			<< "}}" << sync_endl;
 }
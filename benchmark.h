@@ -17,8 +17,12 @@
 #ifndef BENCHMARK_H_
 #define BENCHMARK_H_
 
+#include <string>
 
-void benchmark(void);
+void benchmark(unsigned int depth = 15, unsigned int threads = 1, unsigned int hashSize = 32, const std::string& fenFile = "");
+void smpBenchmark(unsigned int depth = 13, unsigned int maxThreads = 4, unsigned int hashSize = 128, const std::string& fenFile = "");
+void hashBenchmark(unsigned int mbSize);
+void timeBenchmark(unsigned int moveTime = 50, unsigned int searches = 40);
 
 
 #endif /* BENCHMARK_H_ */
@@ -21,9 +21,11 @@
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <chrono>
 #include <iterator>
+#include <thread>
 #include "vajolet.h"
 #include "command.h"
 #include "io.h"
@@ -34,6 +36,9 @@
 #include "thread.h"
 #include "transposition.h"
 #include "benchmark.h"
+#include "nnue.h"
+#include "perfcounters.h"
+#include "perft.h"
 #include "syzygy/tbprobe.h"
 #include "parameters.h"
 
@@ -76,6 +81,11 @@ void static printUciInfo(void)
 	sync_cout << "option name UCI_ShowCurrLine type check default false" << sync_endl;
 	sync_cout << "option name SyzygyPath type string default <empty>" << sync_endl;
 	sync_cout << "option name SyzygyProbeDepth type spin default 1 min 1 max 100" << sync_endl;
+	sync_cout << "option name EvalCache type spin default 1 min 0 max 256" << sync_endl;
+	sync_cout << "option name PawnHash type spin default 1 min 1 max 256" << sync_endl;
+	sync_cout << "option name PerfCounters type check default false" << sync_endl;
+	sync_cout << "option name UseNNUE type check default false" << sync_endl;
+	sync_cout << "option name EvalFile type string default " << nnueNetwork::defaultFileName << sync_endl;
 
 	sync_cout << "uciok" << sync_endl;
 }
@@ -143,17 +153,61 @@ void static position(std::istringstream& is, Position & pos)
 /*	\brief handle perft command
 	\author Marco Belli
 	\version 1.0
+	\version 1.1 threads and hash
 	\date 08/11/2013
 */
-void static doPerft(const unsigned int n, Position & pos)
+void static doPerft(const unsigned int n, Position & pos, const unsigned int threads, const unsigned long int hashSizeMB)
 {
 
 	unsigned long long elapsed = Search::getTime();
-	unsigned long long res = pos.perft(n);
+	Perft pft(pos, threads, hashSizeMB);
+	unsigned long long res = pft.perft(n);
 	elapsed = Search::getTime() - elapsed;
 
 	sync_cout << "Perft " << n << " leaf nodes: " << res << sync_endl;
-	sync_cout << elapsed << "ms " << ((double)res) / (double)elapsed << " kN/s" << sync_endl;
+	sync_cout << elapsed << "ms " << ( res * 1000 ) / std::max( elapsed, 1ull ) << " nps" << sync_endl;
+}
+
+
+/*	\brief read the numeric arguments of a benchmark command
+	reading stops at the first token that is not a whole integer, that token is left in the stream.
+	values are clamped to [1, maxValues[i]]
+	\return false if a number does not fit an int
+*/
+bool static readNumericArguments(std::istringstream& is, int values[], const int maxValues[], const unsigned int count)
+{
+	std::string token;
+	for( unsigned int i = 0; i < count; i++ )
+	{
+		const std::streampos start = is.tellg();
+		if( !( is >> token ) )
+		{
+			break;
+		}
+		size_t length = 0;
+		int value = 0;
+		try
+		{
+			value = std::stoi(token, &length);
+		}
+		catch( const std::invalid_argument& )
+		{
+			length = 0;
+		}
+		catch( const std::out_of_range& )
+		{
+			sync_cout << "info string invalid argument " << token << sync_endl;
+			return false;
+		}
+		if( length != token.size() )
+		{
+			is.clear();
+			is.seekg(start);
+			break;
+		}
+		values[i] = std::min( std::max( value, 1 ), maxValues[i] );
+	}
+	return true;
 }
 
 
@@ -238,8 +292,16 @@ void setoption(std::istringstream& is)
 			hash = 1;
 		}
 		hash = std::min(hash,65535);
-		unsigned long elements = TT.setSize(hash);
+		unsigned long elements = TT.setSize(hash, Search::threads);
 		sync_cout<<"info string hash table allocated, "<<elements<<" elements ("<<hash<<"MB)"<<sync_endl;
+		if( TT.isUsingHugePages() )
+		{
+			sync_cout<<"info string hash table huge pages "<<TT.getHugePagesMB()<<"MB of "<<TT.getSizeMB()<<"MB"<<sync_endl;
+		}
+		else
+		{
+			sync_cout<<"info string hash table huge pages not obtained"<<sync_endl;
+		}
 
 	}
 	else if(name == "Threads")
@@ -335,6 +397,61 @@ void setoption(std::istringstream& is)
 			sync_cout<<"info string Syzygy50MoveRule option set to false"<<sync_endl;
 		}
 	}
+	else if(name == "EvalCache")
+	{
+		try
+		{
+			Search::evalCacheSize = std::min( std::max( std::stoi(value), 0 ), 256 );
+		}
+		catch(...)
+		{
+			Search::evalCacheSize = 1;
+		}
+		sync_cout<<"info string EvalCache option set to "<<Search::evalCacheSize<<"MB"<<sync_endl;
+	}
+	else if(name == "PawnHash")
+	{
+		try
+		{
+			Search::pawnHashSize = std::min( std::max( std::stoi(value), 1 ), 256 );
+		}
+		catch(...)
+		{
+			Search::pawnHashSize = 1;
+		}
+		sync_cout<<"info string PawnHash option set to "<<Search::pawnHashSize<<"MB"<<sync_endl;
+	}
+	else if(name == "PerfCounters")
+	{
+		perfCounters::enabled = ( value == "true" );
+		sync_cout<<"info string PerfCounters option set to "<<( perfCounters::enabled ? "true" : "false" )<<sync_endl;
+	}
+	else if(name == "UseNNUE")
+	{
+		nnueNetwork::enabled = ( value == "true" );
+		sync_cout<<"info string UseNNUE option set to "<<( nnueNetwork::enabled ? "true" : "false" )<<sync_endl;
+		if( nnueNetwork::enabled && !NNUE.isLoaded() )
+		{
+			sync_cout<<"info string no network loaded, the classical evaluation is used"<<sync_endl;
+		}
+	}
+	else if(name == "EvalFile")
+	{
+		std::string error;
+		// the searchers read the network without locking, it can't be replaced under them
+		if( my_thread::getInstance()->isSearching() )
+		{
+			sync_cout<<"info string unable to load network: a search is running"<<sync_endl;
+		}
+		else if( NNUE.load(value, error) )
+		{
+			sync_cout<<"info string network loaded from "<<value<<sync_endl;
+		}
+		else
+		{
+			sync_cout<<"info string unable to load network: "<<error<<sync_endl;
+		}
+	}
 	else if(name == "UCI_EngineAbout")
 	{
 		sync_cout<< PROGRAM_NAME << " " << VERSION << " by Marco Belli (build date: " <<__DATE__<<")"<<sync_endl;
@@ -467,6 +584,7 @@ void uciLoop()
 		}
 		else if (token == "ucinewgame")
 		{
+			TT.clear(Search::threads);
 		}
 		else if (token == "d")
 		{
@@ -502,6 +620,7 @@ void uciLoop()
 		}
 		else if (token == "isready")
 		{
+			// commands are served in order, so any hash allocation/clearing is already finished here
 			sync_cout << "readyok" << sync_endl;
 		}
 		else if (token == "perft" && (is>>token))
@@ -516,7 +635,33 @@ void uciLoop()
 				n = 1;
 			}
 			n = std::max(n,1);
-			doPerft(n, pos);
+
+			// perft depth [threads] [hash MB]
+			int threads = 1;
+			int hashSize = 0;
+			if( is >> token )
+			{
+				try
+				{
+					threads = std::max( std::stoi(token), 1 );
+				}
+				catch(...)
+				{
+					threads = 1;
+				}
+				if( is >> token )
+				{
+					try
+					{
+						hashSize = std::max( std::stoi(token), 0 );
+					}
+					catch(...)
+					{
+						hashSize = 0;
+					}
+				}
+			}
+			doPerft(n, pos, threads, hashSize);
 		}
 		else if (token == "divide" && (is>>token))
 		{
@@ -537,9 +682,119 @@ void uciLoop()
 		{
 			go(is, pos, thr);
 		}
-		else if (token == "bench")
+		else if (token == "bench" || token == "smpbench")
 		{
-			benchmark();
+			// bench [depth] [threads] [hash MB] [fen file]
+			// smpbench [depth] [max threads] [hash MB] [fen file]
+			const bool smp = ( token == "smpbench" );
+			int values[3] = { 15, 1, 32 };
+			if( smp )
+			{
+				values[0] = 13;
+				values[1] = std::max( (int)std::thread::hardware_concurrency(), 1 );
+				values[2] = 128;
+			}
+			const int maxValues[3] = { 100, 128, 65535 };
+			if( readNumericArguments(is, values, maxValues, 3) )
+			{
+				// the rest of the line is the fen file
+				std::string fenFile;
+				std::getline(is, fenFile);
+				const size_t first = fenFile.find_first_not_of(' ');
+				fenFile = ( first == std::string::npos ) ? "" : fenFile.substr(first);
+				if( smp )
+				{
+					smpBenchmark(values[0], values[1], values[2], fenFile);
+				}
+				else
+				{
+					benchmark(values[0], values[1], values[2], fenFile);
+				}
+			}
+		}
+		else if (token == "savehash" && (is>>token))
+		{
+			// the searchers write the table while it is saved
+			if( thr->isSearching() )
+			{
+				sync_cout << "info string unable to save hash table: a search is running" << sync_endl;
+			}
+			else if( TT.save(token) )
+			{
+				sync_cout << "info string hash table saved to " << token << sync_endl;
+			}
+			else
+			{
+				sync_cout << "info string unable to save hash table to " << token << sync_endl;
+			}
+		}
+		else if (token == "loadhash" && (is>>token))
+		{
+			// loading can reallocate the table under the searchers
+			if( thr->isSearching() )
+			{
+				sync_cout << "info string unable to load hash table: a search is running" << sync_endl;
+			}
+			else if( TT.load(token, Search::threads) )
+			{
+				sync_cout << "info string hash table loaded from " << token << sync_endl;
+			}
+			else
+			{
+				sync_cout << "info string unable to load hash table from " << token << sync_endl;
+			}
+		}
+		else if (token == "hashstats")
+		{
+			const evalCacheStats ecs = thr->getSearch().getEvalCacheStats();
+			sync_cout << "info string eval cache probes " << ecs.probes << " hits " << ecs.hits << " (" << ( ecs.probes ? 100.0 * ecs.hits / ecs.probes : 0.0 ) << "%)" << sync_endl;
+#ifdef ENABLE_TT_STATISTICS
+			if( (is>>token) && token == "clear" )
+			{
+				ttStatistics::reset();
+			}
+			else
+			{
+				ttStatistics::print();
+			}
+#else
+			sync_cout << "info string hash statistics not available, build with ENABLE_TT_STATISTICS" << sync_endl;
+#endif
+		}
+		else if (token == "ttbench")
+		{
+			int n = 256;
+			if(is>>token)
+			{
+				try
+				{
+					n = std::stoi(token);
+				}
+				catch(...)
+				{
+					n = 256;
+				}
+			}
+			n = std::min(std::max(n,1),65535);
+			hashBenchmark(n);
+		}
+		else if (token == "timebench")
+		{
+			// timebench [movetime ms] [searches]
+			int values[2] = { 50, 40 };
+			const int maxValues[2] = { 60000, 10000 };
+			if( readNumericArguments(is, values, maxValues, 2) )
+			{
+				std::string extra;
+				if( is >> extra )
+				{
+					sync_cout << "info string invalid argument " << extra << sync_endl;
+				}
+				else
+				{
+					timeBenchmark(values[0], values[1]);
+				}
+			}
 		}
 		else if (token == "ponderhit")
 		{
@@ -733,6 +988,10 @@ std::string displayMove(const Position& pos, const Move & m)
 
 void printCurrMoveNumber(unsigned int moveNumber, const Move &m, unsigned long long visitedNodes, long long int time)
 {
+	if( Search::silentOutput )
+	{
+		return;
+	}
 	sync_cout << "info currmovenumber " << moveNumber << " currmove " << displayUci(m) << " nodes " << visitedNodes <<
 #ifndef DISABLE_TIME_DIPENDENT_OUTPUT
 			" time " << time <<
@@ -742,6 +1001,10 @@ void printCurrMoveNumber(unsigned int moveNumber, const Move &m, unsigned long l
 
 void showCurrLine(const Position & pos, unsigned int ply)
 {
+	if( Search::silentOutput )
+	{
+		return;
+	}
 	sync_cout << "info currline";
 	unsigned int start = pos.getStateSize() - ply;
 
@@ -768,8 +1031,12 @@ void printPVs(unsigned int count)
 	});
 }
 
-void printPV(Score res,unsigned int depth,unsigned int seldepth,Score alpha, Score beta, long long time,unsigned int count,std::list<Move>& PV,unsigned long long nodes)
+void printPV(Score res,unsigned int depth,unsigned int seldepth,Score alpha, Score beta, long long time,unsigned int count,const PVline& PV,unsigned long long nodes)
 {
+	if( Search::silentOutput )
+	{
+		return;
+	}
 
 	sync_cout<<"info multipv "<< (count+1) << " depth "<< (depth) <<" seldepth "<< seldepth <<" score ";
 
@@ -792,6 +1059,6 @@ void printPV(Score res,unsigned int depth,unsigned int seldepth,Score alpha, Sco
 #endif
 
 	std::cout << " pv ";
-	for_each( PV.begin(), PV.end(), [&](Move &m){std::cout<<displayUci(m)<<" ";});
+	std::for_each( PV.begin(), PV.end(), [&](const Move &m){std::cout<<displayUci(m)<<" ";});
 	std::cout<<sync_endl;
 }
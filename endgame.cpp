@@ -32,7 +32,7 @@
 
 
 
-std::unordered_map<U64, Position::materialStruct> Position::materialKeyMap;
+std::unordered_map<U64, materialStruct> Position::materialKeyMap;
 
 
 bool Position::evalKxvsK(Score& res)
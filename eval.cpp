@@ -45,21 +45,52 @@ simdScore traceRes={0,0,0,0};
 
 
 //---------------------------------------------
-const Position::materialStruct * Position::getMaterialData()
+/*! \brief fill the material entry of the actual material signature*/
+void Position::calcMaterialEntry(materialEntry& entry) const
 {
-	U64 key = getMaterialKey();
+	entry.key = getMaterialKey();
 
-	auto got= materialKeyMap.find(key);
+	auto got = materialKeyMap.find(entry.key);
+	entry.endgame = ( got == materialKeyMap.end() ) ? nullptr : &(got->second);
 
-	if( got == materialKeyMap.end())
+	entry.kingVsPieces = ( bitCnt(getBitmap(whitePieces) ) == 1 && bitCnt(getBitmap(blackPieces) ) > 1 ) || ( bitCnt(getBitmap(whitePieces) ) > 1 && bitCnt(getBitmap(blackPieces) ) == 1 );
+	entry.gamePhase = getGamePhase();
+
+	entry.imbalance = simdScore{0, 0, 0, 0};
+	if( getPieceCount(blackPawns) + getPieceCount(whitePawns) == 0 )
 	{
-		return nullptr;
+		if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == 1
+				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == 1
+				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) - (int)getPieceCount(whiteKnights) == 2)
+		{
+			entry.imbalance += queenVsRook2MinorsImbalance;
+
+		}
+		else if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == -1
+				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == -1
+				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) -(int)getPieceCount(whiteKnights) == -2)
+		{
+			entry.imbalance -= queenVsRook2MinorsImbalance;
+
+		}
 	}
-	else
+}
+
+/*! \brief material entry of the position, from the material hash table when the position has one, otherwise calculated in buffer*/
+const materialEntry& Position::getMaterialEntry(materialEntry& buffer)
+{
+	const U64 key = getMaterialKey();
+	if( materialHashTable )
 	{
-		 return &(got->second);
+		materialEntry& entry = materialHashTable->probe(key);
+		if( entry.key != key )
+		{
+			calcMaterialEntry(entry);
+		}
+		return entry;
 	}
-
+	calcMaterialEntry(buffer);
+	return buffer;
 }
 
 
@@ -630,6 +661,10 @@ template<Color c> simdScore Position::evalKingSafety(Score kingSafety, unsigned
 template<bool trace>
 Score Position::eval(void)
 {
+	if( !trace && nnueNetwork::enabled && NNUE.isLoaded() )
+	{
+		return evalNnue();
+	}
 
 	const state &st = getActualState();
 
@@ -685,7 +720,9 @@ Score Position::eval(void)
 	//-----------------------------------------------------
 
 
-	const materialStruct* materialData = getMaterialData();
+	materialEntry materialBuffer;
+	const materialEntry& material = getMaterialEntry(materialBuffer);
+	const materialStruct* materialData = material.endgame;
 	if( materialData )
 	{
 		bool (Position::*pointer)(Score &) = materialData->pointer;
@@ -723,7 +760,7 @@ Score Position::eval(void)
 	else
 	{
 		// analize k and pieces vs king
-		if( (bitCnt(getBitmap(whitePieces) )== 1 && bitCnt(getBitmap(blackPieces) )> 1) || (bitCnt(getBitmap(whitePieces) )> 1 && bitCnt(getBitmap(blackPieces) )== 1) )
+		if( material.kingVsPieces )
 		{
 			Score r;
 			evalKxvsK(r);
@@ -766,23 +803,7 @@ Score Position::eval(void)
 			res -= bishopPair;
 		}
 	}
-	if( getPieceCount(blackPawns) + getPieceCount(whitePawns) == 0 )
-	{
-		if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == 1
-				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == 1
-				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) - (int)getPieceCount(whiteKnights) == 2)
-		{
-			res += queenVsRook2MinorsImbalance;
-
-		}
-		else if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == -1
-				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == -1
-				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) -(int)getPieceCount(whiteKnights) == -2)
-		{
-			res -= queenVsRook2MinorsImbalance;
-
-		}
-	}
+	res += material.imbalance;
 
 	if(trace)
 	{
@@ -806,18 +827,18 @@ Score Position::eval(void)
 	//----------------------------------------------
 	simdScore pawnResult;
 	U64 pawnKey = getPawnKey();
-	pawnEntry& probePawn = pawnHashTable.probe(pawnKey);
-	if( enablePawnHash && (probePawn.key == pawnKey) )
+	pawnEntry* probePawn = ( enablePawnHash && pawnHashTable ) ? pawnHashTable->probe(pawnKey) : nullptr;
+	if( probePawn && (probePawn->key == pawnKey) )
 	{
-		pawnResult = simdScore{probePawn.res[0], probePawn.res[1], 0, 0};
-		weakPawns = probePawn.weakPawns;
-		passedPawns = probePawn.passedPawns;
-		attackedSquares[whitePawns] = probePawn.pawnAttacks[0];
-		attackedSquares[blackPawns] = probePawn.pawnAttacks[1];
-		weakSquares[white] = probePawn.weakSquares[0];
-		weakSquares[black] = probePawn.weakSquares[1];
-		holes[white] = probePawn.holes[0];
-		holes[black] = probePawn.holes[1];
+		pawnResult = simdScore{probePawn->res[0], probePawn->res[1], 0, 0};
+		weakPawns = probePawn->weakPawns;
+		passedPawns = probePawn->passedPawns;
+		attackedSquares[whitePawns] = probePawn->pawnAttacks[0];
+		attackedSquares[blackPawns] = probePawn->pawnAttacks[1];
+		weakSquares[white] = probePawn->weakSquares[0];
+		weakSquares[black] = probePawn->weakSquares[1];
+		holes[white] = probePawn->holes[0];
+		holes[black] = probePawn->holes[1];
 	}
 	else
 	{
@@ -883,9 +904,9 @@ Score Position::eval(void)
 		holes[black] = weakSquares[black] & temp;
 		pawnResult -= ( (int)bitCnt( holes[white] ) - (int)bitCnt( holes[black] ) ) * holesPenalty;
 
-		if(enablePawnHash)
+		if(probePawn)
 		{
-			pawnHashTable.insert(pawnKey, pawnResult, weakPawns, passedPawns, attackedSquares[whitePawns], attackedSquares[blackPawns], weakSquares[white], weakSquares[black], holes[white], holes[black] );
+			pawnHashTable->insert(pawnKey, pawnResult, weakPawns, passedPawns, attackedSquares[whitePawns], attackedSquares[blackPawns], weakSquares[white], weakSquares[black], holes[white], holes[black] );
 		}
 
 	}
@@ -1301,7 +1322,7 @@ Score Position::eval(void)
 	//--------------------------------------
 	//	finalizing
 	//--------------------------------------
-	signed int gamePhase = getGamePhase();
+	signed int gamePhase = material.gamePhase;
 	signed long long r = ( (signed long long)res[0] ) * ( 65536 - gamePhase ) + ( (signed long long)res[1] ) * gamePhase;
 
 	Score score = (Score)( (r) / 65536 );
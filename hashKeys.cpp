@@ -83,6 +83,27 @@ void HashKeys::init()
 
 }
 
+/*!	\brief return a fingerprint of all the hashkeys
+	data saved with a different set of keys (ie. a different seed) is useless
+ */
+U64 HashKeys::getSignature()
+{
+	U64 res = side ^ ( exclusion << 1 );
 
-
-
+	for(auto & outerArray :keys)
+	{
+		for(auto & val :outerArray)
+		{
+			res = ( res << 7 | res >> 57 ) ^ val;
+		}
+	}
+	for(auto & val :ep)
+	{
+		res = ( res << 7 | res >> 57 ) ^ val;
+	}
+	for(auto & val :castlingRight)
+	{
+		res = ( res << 7 | res >> 57 ) ^ val;
+	}
+	return res;
+}
@@ -38,6 +38,7 @@ struct HashKeys
 
 
 	static void init();       // initialize the random data
+	static U64 getSignature();	// fingerprint of the random data, used to validate saved hash tables
 };
 
 
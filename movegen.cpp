@@ -157,23 +157,28 @@ void Movegen::initMovegenConstant(void){
 
 
 
-template<Movegen::genType type>
-void Movegen::generateMoves()
+template<Movegen::genType type, Color c>
+void Movegen::generateColorMoves()
 {
 
 	// initialize constants
+	const Position::eNextMove us = c ? Position::blackTurn : Position::whiteTurn;
+	const Position::eNextMove them = c ? Position::whiteTurn : Position::blackTurn;
 	const Position::state &s =pos.getActualStateConst();
-	const bitMap& enemy = pos.getTheirBitmap(Position::Pieces);
+	const bitMap pinned = pos.getPinnedPieces();
+	const bitMap& enemy = pos.getBitmap((Position::bitboardIndex)(Position::whitePieces + them));
+	const bitMap& ourPieces = pos.getBitmap((Position::bitboardIndex)(Position::whitePieces + us));
 	const bitMap& occupiedSquares = pos.getOccupationBitmap();
 
 	//divide pawns
-	const bitMap& thirdRankMask = RANKMASK[ s.nextMove ? A6:A3];
-	const bitMap& seventhRankMask = RANKMASK[ s.nextMove ? A2:A7];
+	const bitMap& thirdRankMask = RANKMASK[ c ? A6:A3];
+	const bitMap& seventhRankMask = RANKMASK[ c ? A2:A7];
 
-	bitMap promotionPawns =  pos.getOurBitmap(Position::Pawns) & seventhRankMask ;
-	bitMap nonPromotionPawns =  pos.getOurBitmap(Position::Pawns)^ promotionPawns;
+	const bitMap& ourPawns = pos.getBitmap((Position::bitboardIndex)(Position::whitePawns + us));
+	bitMap promotionPawns =  ourPawns & seventhRankMask ;
+	bitMap nonPromotionPawns =  ourPawns ^ promotionPawns;
 
-	const tSquare kingSquare = pos.getSquareOfThePiece((Position::bitboardIndex)(Position::whiteKing+s.nextMove));
+	const tSquare kingSquare = pos.getSquareOfThePiece((Position::bitboardIndex)(Position::whiteKing + us));
 	assert(kingSquare<squareNumber);
 
 	// populate the target squares bitmaps
@@ -182,50 +187,50 @@ void Movegen::generateMoves()
 	if(type==Movegen::allEvasionMg)
 	{
 		assert(s.checkers);
-		target = ( s.checkers | SQUARES_BETWEEN[kingSquare][firstOne(s.checkers)]) &~ pos.getOurBitmap(Position::Pieces);
-		kingTarget = ~pos.getOurBitmap(Position::Pieces);
+		target = ( s.checkers | SQUARES_BETWEEN[kingSquare][firstOne(s.checkers)]) &~ ourPieces;
+		kingTarget = ~ourPieces;
 	}
 	else if(type==Movegen::captureEvasionMg)
 	{
 		assert(s.checkers);
-		target = ( s.checkers ) &~ pos.getOurBitmap(Position::Pieces);
-		kingTarget = target | pos.getTheirBitmap(Position::Pieces);
+		target = ( s.checkers ) &~ ourPieces;
+		kingTarget = target | enemy;
 		//displayBitmap(target);
 	}
 	else if(type==Movegen::quietEvasionMg)
 	{
 		assert(s.checkers);
-		target = ( SQUARES_BETWEEN[kingSquare][firstOne(s.checkers)]) &~ pos.getOurBitmap(Position::Pieces);
-		kingTarget = ~pos.getOccupationBitmap();
+		target = ( SQUARES_BETWEEN[kingSquare][firstOne(s.checkers)]) &~ ourPieces;
+		kingTarget = ~occupiedSquares;
 		//displayBitmap(target);
 		//displayBitmap(kingTarget);
 	}
 	else if(type== Movegen::allNonEvasionMg)
 	{
-		target= ~pos.getOurBitmap(Position::Pieces);
+		target= ~ourPieces;
 		kingTarget= target;
 	}
 	else if(type== Movegen::captureMg)
 	{
-		target = pos.getTheirBitmap(Position::Pieces);
+		target = enemy;
 		kingTarget = target;
 	}
 	else if(type== Movegen::quietMg)
 	{
-		target = ~pos.getOccupationBitmap();
+		target = ~occupiedSquares;
 		kingTarget = target;
 	}
 	else if(type== Movegen::quietChecksMg)
 	{
-		target = ~pos.getOccupationBitmap();
+		target = ~occupiedSquares;
 		kingTarget = target;
 	}else
 	{
 		assert(false);
 		//sync_cout<<"ERRORE"<<sync_endl;
 		assert(s.checkers);
-		target = ( s.checkers | SQUARES_BETWEEN[kingSquare][firstOne(s.checkers)]) &~ pos.getOurBitmap(Position::Pieces);
-		kingTarget = ~pos.getOurBitmap(Position::Pieces);
+		target = ( s.checkers | SQUARES_BETWEEN[kingSquare][firstOne(s.checkers)]) &~ ourPieces;
+		kingTarget = ~ourPieces;
 	}
 
 
@@ -234,7 +239,7 @@ void Movegen::generateMoves()
 	//------------------------------------------------------
 	// king
 	//------------------------------------------------------
-	Position::bitboardIndex piece = (Position::bitboardIndex)( s.nextMove + Position::whiteKing );
+	Position::bitboardIndex piece = (Position::bitboardIndex)( us + Position::whiteKing );
 	assert(pos.isKing(piece));
 	assert(piece<Position::lastBitboard);
 
@@ -248,7 +253,7 @@ void Movegen::generateMoves()
 			tSquare to = iterateBit(moves);
 			m.bit.to = to;
 
-			if( !(pos.getAttackersTo(to, pos.getOccupationBitmap() & ~pos.getOurBitmap(Position::King)) & enemy) )
+			if( !(pos.getAttackersTo(to, occupiedSquares & ~pos.getBitmap((Position::bitboardIndex)(Position::whiteKing + us))) & enemy) )
 			{
 				if(type !=Movegen::quietChecksMg || pos.moveGivesCheck(m))
 				{
@@ -282,7 +287,7 @@ void Movegen::generateMoves()
 			tSquare to = iterateBit(moves);
 			m.bit.to = to;
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from, to, kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from, to, kingSquare))
 			{
 				if(type !=Movegen::quietChecksMg || pos.moveGivesCheck(m))
 				{
@@ -310,7 +315,7 @@ void Movegen::generateMoves()
 			tSquare to = iterateBit(moves);
 			m.bit.to = to;
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from, to, kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from, to, kingSquare))
 			{
 				if(type !=Movegen::quietChecksMg || pos.moveGivesCheck(m))
 				{
@@ -338,7 +343,7 @@ void Movegen::generateMoves()
 			tSquare to = iterateBit(moves);
 			m.bit.to = to;
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from,to,kingSquare))
 			{
 				if(type !=Movegen::quietChecksMg || pos.moveGivesCheck(m))
 				{
@@ -362,7 +367,7 @@ void Movegen::generateMoves()
 		assert(from<squareNumber);
 		m.bit.from = from;
 
-		if(!(s.pinnedPieces & bitSet(from)))
+		if(!(pinned & bitSet(from)))
 		{
 			moves = attackFromKnight(from) & target;
 			while (moves)
@@ -385,7 +390,7 @@ void Movegen::generateMoves()
 	{
 		bitMap pawnPushed;
 		//push
-		moves = (s.nextMove? (nonPromotionPawns>>8):(nonPromotionPawns<<8)) & ~occupiedSquares;
+		moves = (c ? (nonPromotionPawns>>8):(nonPromotionPawns<<8)) & ~occupiedSquares;
 		pawnPushed = moves;
 		moves &= target;
 		//displayBitmap(moves);
@@ -393,12 +398,12 @@ void Movegen::generateMoves()
 		while(moves)
 		{
 			tSquare to = iterateBit(moves);
-			tSquare from = to - pawnPush(s.nextMove);
+			tSquare from = to - pawnPush(c);
 
 			m.bit.to= to;
 			m.bit.from = from;
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from,to,kingSquare))
 			{
 				if(type !=Movegen::quietChecksMg || pos.moveGivesCheck(m))
 				{
@@ -408,17 +413,17 @@ void Movegen::generateMoves()
 		}
 
 		//double push
-		moves = (s.nextMove? ((pawnPushed & thirdRankMask)>>8):((pawnPushed & thirdRankMask)<<8)) & ~occupiedSquares & target;
+		moves = (c ? ((pawnPushed & thirdRankMask)>>8):((pawnPushed & thirdRankMask)<<8)) & ~occupiedSquares & target;
 
 		//displayBitmap(moves);
 		while(moves)
 		{
 			tSquare to = iterateBit(moves);
-			tSquare from = to - 2*pawnPush(s.nextMove);
+			tSquare from = to - 2*pawnPush(c);
 
 			m.bit.to = to;
 			m.bit.from = from;
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from ,to ,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from ,to ,kingSquare))
 			{
 				if(type !=Movegen::quietChecksMg || pos.moveGivesCheck(m))
 				{
@@ -428,20 +433,20 @@ void Movegen::generateMoves()
 		}
 	}
 
-	int delta;
+	const int leftDelta = c ? -9 : 7;
+	const int rightDelta = c ? -7 : 9;
 
 	if(type!= Movegen::quietMg && type!=Movegen::quietChecksMg && type != Movegen::quietEvasionMg)
 	{
 		//left capture
-		delta = s.nextMove?-9:7;
 
-		moves = (s.nextMove?(nonPromotionPawns&(~FILEMASK[A1]))>>9:(nonPromotionPawns&(~FILEMASK[A1]))<<7) & enemy & target;
+		moves = (c ? (nonPromotionPawns&(~FILEMASK[A1]))>>9:(nonPromotionPawns&(~FILEMASK[A1]))<<7) & enemy & target;
 		while(moves)
 		{
 			tSquare to = iterateBit(moves);
-			tSquare from = (tSquare)(to - delta);
+			tSquare from = (tSquare)(to - leftDelta);
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from,to,kingSquare))
 			{
 				m.bit.to = to;
 				m.bit.from = from;
@@ -450,16 +455,15 @@ void Movegen::generateMoves()
 		}
 
 		//right capture
-		delta=s.nextMove?-7:9;
 
-		moves = (s.nextMove?(nonPromotionPawns&(~FILEMASK[H1]))>>7:(nonPromotionPawns&(~FILEMASK[H1]))<<9) & enemy & target;
+		moves = (c ? (nonPromotionPawns&(~FILEMASK[H1]))>>7:(nonPromotionPawns&(~FILEMASK[H1]))<<9) & enemy & target;
 		while(moves)
 		{
 			tSquare to = iterateBit(moves);
-			tSquare from = (tSquare)(to -delta);
+			tSquare from = (tSquare)(to - rightDelta);
 
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from,to,kingSquare))
 			{
 				m.bit.to = to;
 				m.bit.from = from;
@@ -472,16 +476,16 @@ void Movegen::generateMoves()
 	m.bit.flags = Move::fpromotion;
 	if(type != Movegen::captureMg && type != Movegen::captureEvasionMg)
 	{
-		moves = (s.nextMove? (promotionPawns>>8):(promotionPawns<<8))& ~occupiedSquares & target;
+		moves = (c ? (promotionPawns>>8):(promotionPawns<<8))& ~occupiedSquares & target;
 		while(moves)
 		{
 			tSquare to = iterateBit(moves);
-			tSquare from = to - pawnPush(s.nextMove);
+			tSquare from = to - pawnPush(c);
 
 			m.bit.to = to;
 			m.bit.from = from;
 
-			if(!(s.pinnedPieces & bitSet(from)) ||	squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) ||	squaresAligned(from,to,kingSquare))
 			{
 				for(Move::epromotion prom=Move::promQueen; prom<= Move::promKnight; prom=(Move::epromotion)(prom+1))
 				{
@@ -492,22 +496,19 @@ void Movegen::generateMoves()
 		}
 	}
 
-	int color = s.nextMove?1:0;
-
 	if( type!= Movegen::quietMg && type!= Movegen::quietChecksMg && type!= Movegen::quietEvasionMg)
 	{
 		//left capture
-		delta = s.nextMove?-9:7;
-		moves = (s.nextMove?(promotionPawns&(~FILEMASK[A1]))>>9:(promotionPawns&(~FILEMASK[A1]))<<7) & enemy & target;
+		moves = (c ? (promotionPawns&(~FILEMASK[A1]))>>9:(promotionPawns&(~FILEMASK[A1]))<<7) & enemy & target;
 		while(moves)
 		{
 			tSquare to = iterateBit(moves);
-			tSquare from = (tSquare)(to -delta);
+			tSquare from = (tSquare)(to - leftDelta);
 
 			m.bit.to=to;
 			m.bit.from=from;
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from,to,kingSquare))
 			{
 				for(Move::epromotion prom=Move::promQueen;prom<= Move::promKnight; prom=(Move::epromotion)(prom+1))
 				{
@@ -518,18 +519,17 @@ void Movegen::generateMoves()
 		}
 
 		//right capture
-		delta=s.nextMove?-7:9;
-		moves = (s.nextMove?(promotionPawns&(~FILEMASK[H1]))>>7:(promotionPawns&(~FILEMASK[H1]))<<9) & enemy & target;
+		moves = (c ? (promotionPawns&(~FILEMASK[H1]))>>7:(promotionPawns&(~FILEMASK[H1]))<<9) & enemy & target;
 		while(moves)
 		{
 
 			tSquare to = iterateBit(moves);
-			tSquare from = (tSquare)(to -delta);
+			tSquare from = (tSquare)(to - rightDelta);
 
 			m.bit.to=to;
 			m.bit.from=from;
 
-			if(!(s.pinnedPieces & bitSet(from)) || squaresAligned(from,to,kingSquare))
+			if(!(pinned & bitSet(from)) || squaresAligned(from,to,kingSquare))
 			{
 				for(Move::epromotion prom=Move::promQueen;prom<= Move::promKnight; prom=(Move::epromotion)(prom+1))
 				{
@@ -547,7 +547,7 @@ void Movegen::generateMoves()
 		if(s.epSquare != squareNone)
 		{
 			m.bit.flags = Move::fenpassant;
-			bitMap epAttacker = nonPromotionPawns & attackFromPawn(s.epSquare,1-color);
+			bitMap epAttacker = nonPromotionPawns & attackFromPawn(s.epSquare,1-c);
 
 			while(epAttacker)
 			{
@@ -556,8 +556,8 @@ void Movegen::generateMoves()
 				bitMap captureSquare= FILEMASK[s.epSquare] & RANKMASK[from];
 				bitMap occ = occupiedSquares^bitSet(from)^bitSet(s.epSquare)^captureSquare;
 
-				if(	!((attackFromRook(kingSquare, occ) & (pos.getTheirBitmap(Position::Queens) | pos.getTheirBitmap(Position::Rooks))) |
-						(Movegen::attackFromBishop(kingSquare, occ) & (pos.getTheirBitmap(Position::Queens) | pos.getTheirBitmap(Position::Bishops))))
+				if(	!((attackFromRook(kingSquare, occ) & (pos.getBitmap((Position::bitboardIndex)(Position::whiteQueens + them)) | pos.getBitmap((Position::bitboardIndex)(Position::whiteRooks + them)))) |
+						(Movegen::attackFromBishop(kingSquare, occ) & (pos.getBitmap((Position::bitboardIndex)(Position::whiteQueens + them)) | pos.getBitmap((Position::bitboardIndex)(Position::whiteBishops + them)))))
 				)
 				{
 					m.bit.to = s.epSquare;
@@ -576,17 +576,17 @@ void Movegen::generateMoves()
 	if(type !=Movegen::allEvasionMg && type!=Movegen::captureEvasionMg && type!=Movegen::quietEvasionMg && type!= Movegen::captureMg)
 	{
 		m.bit.promotion = 0;
-		if(s.castleRights & ((Position::wCastleOO |Position::wCastleOOO)<<(2*color)))
+		if(s.castleRights & ((Position::wCastleOO |Position::wCastleOOO)<<(2*c)))
 		{
 
-			if((s.castleRights &((Position::wCastleOO)<<(2*color))) &&!s.checkers &&!(castlePath[color][kingSideCastle] & pos.getOccupationBitmap()))
+			if((s.castleRights &((Position::wCastleOO)<<(2*c))) &&!s.checkers &&!(castlePath[c][kingSideCastle] & occupiedSquares))
 			{
 
 				bool castleDenied = false;
 				for( tSquare x = (tSquare)1; x<3; x++)
 				{
 					assert(kingSquare+x<squareNumber);
-					if(pos.getAttackersTo(kingSquare+x,pos.getOccupationBitmap()) & pos.getTheirBitmap(Position::Pieces))
+					if(pos.getAttackersTo(kingSquare+x,occupiedSquares) & enemy)
 					{
 						castleDenied = true;
 						break;
@@ -605,13 +605,13 @@ void Movegen::generateMoves()
 
 
 			}
-			if((s.castleRights &((Position::wCastleOOO)<<(2*color))) && !s.checkers && !(castlePath[color][queenSideCastle] & pos.getOccupationBitmap()))
+			if((s.castleRights &((Position::wCastleOOO)<<(2*c))) && !s.checkers && !(castlePath[c][queenSideCastle] & occupiedSquares))
 			{
 				bool castleDenied = false;
 				for( tSquare x = (tSquare)1 ;x<3 ;x++)
 				{
 					assert(kingSquare-x<squareNumber);
-					if(pos.getAttackersTo(kingSquare-x, pos.getOccupationBitmap()) & pos.getTheirBitmap(Position::Pieces))
+					if(pos.getAttackersTo(kingSquare-x, occupiedSquares) & enemy)
 					{
 						castleDenied = true;
 						break;
@@ -631,6 +631,20 @@ void Movegen::generateMoves()
 		}
 	}
 }
+
+template<Movegen::genType type>
+void Movegen::generateMoves()
+{
+	// dispatch once on the side to move, the colour dependent paths of the generator are compile time constants
+	if( pos.getNextTurn() == Position::whiteTurn )
+	{
+		generateColorMoves<type, white>();
+	}
+	else
+	{
+		generateColorMoves<type, black>();
+	}
+}
 template void Movegen::generateMoves<Movegen::captureMg>();
 template void Movegen::generateMoves<Movegen::quietMg>();
 template void Movegen::generateMoves<Movegen::quietChecksMg>();
@@ -115,6 +115,7 @@ private:
 	}stagedGeneratorState;
 
 	template<Movegen::genType type>	void generateMoves();
+	template<Movegen::genType type, Color c> void generateColorMoves();
 
 	void insertMove(const Move& m)
 	{
@@ -0,0 +1,272 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "nnue.h"
+#include "position.h"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+
+nnueNetwork NNUE;
+bool nnueNetwork::enabled = false;
+const std::string nnueNetwork::defaultFileName = "vajolet.nnue";
+
+
+template<typename T>
+static bool readValues(std::ifstream& ifs, T* values, const size_t n)
+{
+	return (bool)ifs.read( reinterpret_cast<char*>(values), n * sizeof(T) );
+}
+
+bool nnueNetwork::load(const std::string& name, std::string& error)
+{
+	std::ifstream ifs(name, std::ios::binary);
+	if( !ifs.is_open() )
+	{
+		error = "cannot open " + name;
+		return false;
+	}
+
+	char magic[4];
+	uint32_t header[5];
+	int32_t scale;
+	if( !readValues(ifs, magic, 4) || !readValues(ifs, header, 5) || !readValues(ifs, &scale, 1) )
+	{
+		error = "truncated header";
+		return false;
+	}
+	if( std::memcmp(magic, "VNUE", 4) != 0 || header[0] != 1 )
+	{
+		error = "not a Vajolet network file";
+		return false;
+	}
+	if( header[1] != inputs || header[2] != nnueAccumulator::size || header[3] != hidden1 || header[4] != hidden2 )
+	{
+		error = "unsupported network architecture";
+		return false;
+	}
+
+	std::unique_ptr<networkData> data(new networkData);
+	data->outputScale = scale;
+	if( !readValues(ifs, data->featureBias, nnueAccumulator::size)
+		|| !readValues(ifs, &data->featureWeights[0][0], inputs * nnueAccumulator::size)
+		|| !readValues(ifs, data->bias1, hidden1)
+		|| !readValues(ifs, &data->weights1[0][0], hidden1 * 2 * nnueAccumulator::size)
+		|| !readValues(ifs, data->bias2, hidden2)
+		|| !readValues(ifs, &data->weights2[0][0], hidden2 * hidden1)
+		|| !readValues(ifs, &data->outputBias, 1)
+		|| !readValues(ifs, data->outputWeights, hidden2) )
+	{
+		error = "truncated network";
+		return false;
+	}
+	if( ifs.peek() != std::ifstream::traits_type::eof() )
+	{
+		error = "unexpected data at the end of the network";
+		return false;
+	}
+
+	net = std::move(data);
+	fileName = name;
+	return true;
+}
+
+void nnueNetwork::addFeature(nnueAccumulator& acc, const unsigned int perspective, const unsigned int piece, const tSquare sq) const
+{
+	const int16_t* w = net->featureWeights[ featureIndex(perspective, piece, sq) ];
+	int16_t* v = acc.values[perspective];
+	for( unsigned int i = 0; i < nnueAccumulator::size; ++i )
+	{
+		v[i] += w[i];
+	}
+}
+
+void nnueNetwork::subFeature(nnueAccumulator& acc, const unsigned int perspective, const unsigned int piece, const tSquare sq) const
+{
+	const int16_t* w = net->featureWeights[ featureIndex(perspective, piece, sq) ];
+	int16_t* v = acc.values[perspective];
+	for( unsigned int i = 0; i < nnueAccumulator::size; ++i )
+	{
+		v[i] -= w[i];
+	}
+}
+
+void nnueNetwork::resetAccumulator(nnueAccumulator& acc) const
+{
+	std::copy( net->featureBias, net->featureBias + nnueAccumulator::size, acc.values[white] );
+	std::copy( net->featureBias, net->featureBias + nnueAccumulator::size, acc.values[black] );
+}
+
+void nnueNetwork::updateAccumulator(const nnueAccumulator& parent, nnueAccumulator& acc, const dirtyPieces& dp) const
+{
+	acc = parent;
+	for( unsigned int perspective = white; perspective <= black; ++perspective )
+	{
+		for( unsigned int i = 0; i < dp.count; ++i )
+		{
+			if( dp.from[i] != squareNone )
+			{
+				subFeature(acc, perspective, dp.piece[i], dp.from[i]);
+			}
+			if( dp.to[i] != squareNone )
+			{
+				addFeature(acc, perspective, dp.piece[i], dp.to[i]);
+			}
+		}
+	}
+}
+
+/*! \brief fully connected layer followed by the clipped relu
+	the rows are processed four at a time so that every input load is shared and the four sums are reduced together.
+	unaligned loads, the makefile builds in c++11 without aligned new. inSize shall be a multiple of 16 and outSize of 4
+*/
+template<unsigned int inSize, unsigned int outSize>
+static inline void denseLayer(const int16_t* input, const int16_t (*weights)[inSize], const int32_t* bias, int16_t* output)
+{
+	for( unsigned int i = 0; i < outSize; i += 4 )
+	{
+		int32_t sums[4];
+#if defined(__AVX2__)
+		__m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+		for( unsigned int j = 0; j < inSize; j += 16 )
+		{
+			const __m256i in = _mm256_loadu_si256( (const __m256i*)( input + j ) );
+			s0 = _mm256_add_epi32( s0, _mm256_madd_epi16( in, _mm256_loadu_si256( (const __m256i*)( weights[i] + j ) ) ) );
+			s1 = _mm256_add_epi32( s1, _mm256_madd_epi16( in, _mm256_loadu_si256( (const __m256i*)( weights[i + 1] + j ) ) ) );
+			s2 = _mm256_add_epi32( s2, _mm256_madd_epi16( in, _mm256_loadu_si256( (const __m256i*)( weights[i + 2] + j ) ) ) );
+			s3 = _mm256_add_epi32( s3, _mm256_madd_epi16( in, _mm256_loadu_si256( (const __m256i*)( weights[i + 3] + j ) ) ) );
+		}
+		const __m256i h = _mm256_hadd_epi32( _mm256_hadd_epi32(s0, s1), _mm256_hadd_epi32(s2, s3) );
+		_mm_storeu_si128( (__m128i*)sums, _mm_add_epi32( _mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1) ) );
+#elif defined(__SSE4_1__)
+		__m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+		for( unsigned int j = 0; j < inSize; j += 8 )
+		{
+			const __m128i in = _mm_loadu_si128( (const __m128i*)( input + j ) );
+			s0 = _mm_add_epi32( s0, _mm_madd_epi16( in, _mm_loadu_si128( (const __m128i*)( weights[i] + j ) ) ) );
+			s1 = _mm_add_epi32( s1, _mm_madd_epi16( in, _mm_loadu_si128( (const __m128i*)( weights[i + 1] + j ) ) ) );
+			s2 = _mm_add_epi32( s2, _mm_madd_epi16( in, _mm_loadu_si128( (const __m128i*)( weights[i + 2] + j ) ) ) );
+			s3 = _mm_add_epi32( s3, _mm_madd_epi16( in, _mm_loadu_si128( (const __m128i*)( weights[i + 3] + j ) ) ) );
+		}
+		_mm_storeu_si128( (__m128i*)sums, _mm_hadd_epi32( _mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3) ) );
+#else
+		for( unsigned int k = 0; k < 4; ++k )
+		{
+			sums[k] = 0;
+			for( unsigned int j = 0; j < inSize; ++j )
+			{
+				sums[k] += (int32_t)input[j] * weights[i + k][j];
+			}
+		}
+#endif
+		for( unsigned int k = 0; k < 4; ++k )
+		{
+			const int32_t v = ( bias[i + k] + sums[k] ) >> nnueNetwork::weightShift;
+			output[i + k] = (int16_t)std::min( std::max( v, 0 ), nnueNetwork::activationMax );
+		}
+	}
+}
+
+Score nnueNetwork::evaluate(const nnueAccumulator& acc, const unsigned int sideToMove) const
+{
+	alignas(32) int16_t input[ 2 * nnueAccumulator::size ];
+	alignas(32) int16_t out1[hidden1];
+	alignas(32) int16_t out2[hidden2];
+
+	// side to move first
+	const int16_t* us = acc.values[ sideToMove ];
+	const int16_t* them = acc.values[ sideToMove ^ 1 ];
+	for( unsigned int i = 0; i < nnueAccumulator::size; ++i )
+	{
+		input[i] = std::min( std::max( us[i], (int16_t)0 ), (int16_t)activationMax );
+		input[ nnueAccumulator::size + i ] = std::min( std::max( them[i], (int16_t)0 ), (int16_t)activationMax );
+	}
+
+	denseLayer<2 * nnueAccumulator::size, hidden1>(input, net->weights1, net->bias1, out1);
+	denseLayer<hidden1, hidden2>(out1, net->weights2, net->bias2, out2);
+
+	int64_t output = net->outputBias;
+	for( unsigned int i = 0; i < hidden2; ++i )
+	{
+		output += (int32_t)out2[i] * net->outputWeights[i];
+	}
+	const int64_t score = output * net->outputScale / 1024;
+	return (Score)std::min( std::max( score, (int64_t)-SCORE_KNOWN_WIN ), (int64_t)SCORE_KNOWN_WIN );
+}
+
+
+/*! \brief bring the accumulator of the state index up to date
+	it is updated forward from the last computed state before it with the dirty pieces of every move,
+	when there is none close enough it is calculated from the board
+*/
+void Position::calcAccumulator(const unsigned int index)
+{
+	// a refresh adds about 30 features for each side, an update moves at most 3 pieces
+	static const unsigned int maxUpdates = 8;
+
+	unsigned int first = index;
+	while( first > 0 && !stateInfo2[first].accumulatorComputed && index - first < maxUpdates )
+	{
+		--first;
+	}
+
+	if( !stateInfo2[first].accumulatorComputed )
+	{
+		nnueAccumulator& acc = accumulators[index];
+		NNUE.resetAccumulator(acc);
+		for( int piece = whiteKing; piece < lastBitboard; ++piece )
+		{
+			if( piece == whitePieces || piece == separationBitmap || piece == blackPieces )
+			{
+				continue;
+			}
+			bitMap b = bitBoard[piece];
+			while( b )
+			{
+				const tSquare sq = iterateBit(b);
+				NNUE.addFeature(acc, white, piece, sq);
+				NNUE.addFeature(acc, black, piece, sq);
+			}
+		}
+		stateInfo2[index].accumulatorComputed = true;
+		return;
+	}
+
+	for( unsigned int i = first + 1; i <= index; ++i )
+	{
+		NNUE.updateAccumulator(accumulators[i - 1], accumulators[i], stateInfo2[i].dirty);
+		stateInfo2[i].accumulatorComputed = true;
+	}
+}
+
+/*! \brief evaluation of the network, from the point of view of the side to move*/
+Score Position::evalNnue(void)
+{
+	assert( NNUE.isLoaded() );
+	if( accumulators.size() < stateInfo2.size() )
+	{
+		accumulators.resize( stateInfo2.size() );
+	}
+	const unsigned int index = getStateSize() - 1;
+	calcAccumulator(index);
+	return NNUE.evaluate( accumulators[index], getNextTurn() ? black : white );
+}
@@ -0,0 +1,110 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "vajolet.h"
+
+
+/*! \brief first layer of the network for both the perspectives, updated incrementally along the search*/
+struct alignas(32) nnueAccumulator
+{
+	static const unsigned int size = 256;
+	int16_t values[2][size];	/*!< indexed by the perspective colour*/
+};
+
+/*! \brief pieces added, removed or moved by a move, used to update the accumulator of the parent state*/
+struct dirtyPieces
+{
+	static const unsigned int maxPieces = 3;
+	unsigned int count;
+	unsigned int piece[maxPieces];	/*!< bitboardIndex of the piece*/
+	tSquare from[maxPieces];	/*!< squareNone for an added piece*/
+	tSquare to[maxPieces];	/*!< squareNone for a removed piece*/
+};
+
+/*! \brief efficiently updatable neural network
+	768 inputs (piece type, own/enemy, square seen by each side) -> 2x256 accumulator -> 32 -> 32 -> 1, clipped relu activations.
+
+	network file, little endian:
+		char[4] "VNUE", uint32 version (1), uint32 inputs (768), uint32 accumulator size (256), uint32 hidden1 (32), uint32 hidden2 (32), int32 outputScale
+		int16 featureBias[256], int16 featureWeights[768][256]
+		int32 bias1[32], int16 weights1[32][512]
+		int32 bias2[32], int16 weights2[32][32]
+		int32 outputBias, int16 outputWeights[32]
+	the hidden layer sums are shifted right by weightShift bits, the output is multiplied by outputScale / 1024 to get the score (10000 = 1 pawn)
+*/
+class nnueNetwork
+{
+public:
+	static const unsigned int inputs = 768;
+	static const unsigned int hidden1 = 32;
+	static const unsigned int hidden2 = 32;
+	static const unsigned int weightShift = 6;
+	static const int activationMax = 127;
+
+	/*! \brief use the network for the evaluation when it is loaded, set by the UseNNUE UCI option*/
+	static bool enabled;
+	static const std::string defaultFileName;
+
+	/*! \brief load a network file, on failure the previous network is kept and error tells why*/
+	bool load(const std::string& fileName, std::string& error);
+	bool isLoaded() const { return (bool)net; }
+	const std::string& getFileName() const { return fileName; }
+
+	/*! \brief input feature of a piece as seen by the perspective side*/
+	static inline unsigned int featureIndex(const unsigned int perspective, const unsigned int piece, const tSquare sq)
+	{
+		const unsigned int pieceColor = ( piece & 8 ) ? 1 : 0;
+		const unsigned int relativeSquare = perspective ? ( sq ^ 56 ) : sq;
+		return ( ( ( pieceColor != perspective ) * 6 + ( piece & 7 ) - 1 ) << 6 ) + relativeSquare;
+	}
+
+	void addFeature(nnueAccumulator& acc, const unsigned int perspective, const unsigned int piece, const tSquare sq) const;
+	void subFeature(nnueAccumulator& acc, const unsigned int perspective, const unsigned int piece, const tSquare sq) const;
+	void resetAccumulator(nnueAccumulator& acc) const;
+	/*! \brief apply the pieces changed by a move to a copy of the parent accumulator*/
+	void updateAccumulator(const nnueAccumulator& parent, nnueAccumulator& acc, const dirtyPieces& dp) const;
+
+	/*! \brief score of the position from the point of view of the side to move*/
+	Score evaluate(const nnueAccumulator& acc, const unsigned int sideToMove) const;
+
+private:
+	struct networkData
+	{
+		alignas(32) int16_t featureBias[nnueAccumulator::size];
+		alignas(32) int16_t featureWeights[inputs][nnueAccumulator::size];
+		alignas(32) int32_t bias1[hidden1];
+		alignas(32) int16_t weights1[hidden1][2 * nnueAccumulator::size];
+		alignas(32) int32_t bias2[hidden2];
+		alignas(32) int16_t weights2[hidden2][hidden1];
+		int32_t outputBias;
+		alignas(32) int16_t outputWeights[hidden2];
+		int32_t outputScale;
+	};
+
+	std::unique_ptr<networkData> net;
+	std::string fileName;
+};
+
+extern nnueNetwork NNUE;
+
+#endif /* NNUE_H_ */
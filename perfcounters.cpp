@@ -0,0 +1,196 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <sstream>
+#include <iomanip>
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+bool perfCounters::enabled = false;
+
+const char* const perfCounters::names[counterNumber] = { "cycles", "instructions", "l1dMisses", "llcMisses", "branchMisses", "dtlbMisses" };
+
+perfCounters::perfCounters()
+{
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		fd[i] = -1;
+		values[i] = -1;
+	}
+}
+
+perfCounters::~perfCounters()
+{
+#ifdef __linux__
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		if( fd[i] >= 0 )
+		{
+			close(fd[i]);
+		}
+	}
+#endif
+}
+
+/*! \brief open the counters the first time they are used, on the calling thread*/
+void perfCounters::open()
+{
+	opened = true;
+#ifdef __linux__
+	struct eventType
+	{
+		unsigned int type;
+		unsigned long long config;
+	};
+	const eventType events[counterNumber] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) }
+	};
+
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		// the counters can be multiplexed by the kernel, the running time is used to scale them
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if( fd[i] >= 0 )
+		{
+			available = true;
+		}
+		else if( error.empty() )
+		{
+			error = std::strerror(errno);
+		}
+	}
+#else
+	error = "perf_event_open is available only on linux";
+#endif
+}
+
+bool perfCounters::start()
+{
+	if( !opened )
+	{
+		open();
+	}
+#ifdef __linux__
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		values[i] = -1;
+		if( fd[i] >= 0 )
+		{
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+	return available;
+}
+
+void perfCounters::stop()
+{
+#ifdef __linux__
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		if( fd[i] < 0 )
+		{
+			continue;
+		}
+		ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+		// value, time enabled, time running
+		unsigned long long data[3];
+		if( read(fd[i], data, sizeof(data)) == sizeof(data) && data[2] > 0 )
+		{
+			values[i] = data[2] < data[1] ? (long long int)( (double)data[0] * data[1] / data[2] ) : data[0];
+		}
+	}
+#endif
+}
+
+std::string perfCounters::toInfoString() const
+{
+	std::ostringstream ss;
+	ss << "info string perf";
+	if( !available )
+	{
+		ss << " counters not available: " << error;
+		return ss.str();
+	}
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		ss << " " << names[i] << " ";
+		if( isValid( (counter)i ) )
+		{
+			ss << values[i];
+		}
+		else
+		{
+			ss << "n/a";
+		}
+	}
+	if( isValid(cycles) && isValid(instructions) && values[cycles] > 0 )
+	{
+		ss << " ipc " << std::fixed << std::setprecision(2) << (double)values[instructions] / values[cycles];
+	}
+	return ss.str();
+}
+
+std::string perfCounters::toJson() const
+{
+	if( !available )
+	{
+		return "null";
+	}
+	std::ostringstream ss;
+	ss << "{";
+	for( int i = 0; i < counterNumber; i++ )
+	{
+		ss << ( i ? "," : "" ) << "\"" << names[i] << "\":";
+		if( isValid( (counter)i ) )
+		{
+			ss << values[i];
+		}
+		else
+		{
+			ss << "null";
+		}
+	}
+	ss << "}";
+	return ss.str();
+}
@@ -0,0 +1,75 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#include <string>
+
+
+/*! \brief hardware performance counters of the calling thread, read with the linux perf_event_open interface
+	a counter that the kernel or the cpu doesn't provide is reported as not available, the other ones still work.
+	on other systems or without the permission to open them (see /proc/sys/kernel/perf_event_paranoid) nothing is measured
+*/
+class perfCounters
+{
+public:
+	enum counter
+	{
+		cycles,
+		instructions,
+		l1dMisses,
+		llcMisses,
+		branchMisses,
+		dtlbMisses,
+		counterNumber
+	};
+
+	/*! \brief measure the searches, set by the PerfCounters UCI option*/
+	static bool enabled;
+
+	perfCounters();
+	~perfCounters();
+	perfCounters(const perfCounters&) = delete;
+	perfCounters& operator=(const perfCounters&) = delete;
+
+	/*! \brief reset and start the counters, returns false when no counter is available*/
+	bool start();
+	void stop();
+
+	bool isAvailable() const { return available; }
+	const std::string& getError() const { return error; }
+
+	/*! \brief "info string perf ..." line*/
+	std::string toInfoString() const;
+	/*! \brief JSON object with the counters, null for the not available ones*/
+	std::string toJson() const;
+
+private:
+	static const char* const names[counterNumber];
+
+	int fd[counterNumber];
+	long long int values[counterNumber];
+	bool opened = false;
+	bool available = false;
+	std::string error;
+
+	void open();
+	bool isValid(counter c) const { return fd[c] >= 0 && values[c] >= 0; }
+};
+
+#endif /* PERFCOUNTERS_H_ */
@@ -0,0 +1,137 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "perft.h"
+#include "movegen.h"
+
+
+void perftTranspositionTable::setSize(unsigned long int mbSize)
+{
+	table.reset();
+	mask = 0;
+	if( mbSize == 0 )
+	{
+		return;
+	}
+
+	// power of two number of entries, so that the index is a mask of the key
+	const U64 entries = ( (U64)mbSize << 20 ) / sizeof(perftEntry);
+	U64 size = 1;
+	while( size * 2 <= entries )
+	{
+		size *= 2;
+	}
+
+	table.reset( new perftEntry[size] );
+	for( U64 i = 0; i < size; ++i )
+	{
+		table[i].keyCheck.store(0, std::memory_order_relaxed);
+		table[i].data.store(0, std::memory_order_relaxed);
+	}
+	mask = size - 1;
+}
+
+
+Perft::Perft(const Position& pos, unsigned int threads, unsigned long int hashSizeMB): rootPosition(pos), threads(std::max(threads, 1u)), tt(ownTable)
+{
+	tt.setSize(hashSizeMB);
+}
+
+Perft::Perft(const Position& pos, unsigned int threads, perftTranspositionTable& table): rootPosition(pos), threads(std::max(threads, 1u)), tt(table)
+{
+}
+
+/*! \brief calculate the perft result
+	the threads take the root moves one at a time from a shared counter and each one walks the subtree on its own copy of the position
+*/
+unsigned long long Perft::perft(unsigned int depth)
+{
+	if( depth == 0 )
+	{
+		return 1;
+	}
+
+	Movegen mg(rootPosition);
+	const unsigned int rootMoves = mg.getNumberOfLegalMoves();
+	if( depth == 1 )
+	{
+		return rootMoves;
+	}
+
+	std::atomic<unsigned int> nextMove(0);
+	std::atomic<unsigned long long> total(0);
+
+	auto worker = [&]()
+	{
+		std::unique_ptr<Position> pos(new Position(rootPosition));
+		unsigned long long count = 0;
+		unsigned int i;
+		while( ( i = nextMove++ ) < rootMoves )
+		{
+			pos->doMove(mg.getMoveFromMoveList(i));
+			count += perftThread(*pos, depth - 1);
+			pos->undoMove();
+		}
+		total += count;
+	};
+
+	std::vector<std::thread> pool;
+	for( unsigned int i = 1; i < threads; ++i )
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+	for( auto& t: pool )
+	{
+		t.join();
+	}
+
+	return total;
+}
+
+unsigned long long Perft::perftThread(Position& pos, unsigned int depth)
+{
+	unsigned long long tot = 0;
+	const bool hashed = depth > 1 && tt.isEnabled();
+	if( hashed && tt.probe(pos.getKey(), depth, tot) )
+	{
+		return tot;
+	}
+
+	Movegen mg(pos);
+	const unsigned int moves = mg.getNumberOfLegalMoves();
+	if( depth == 1 )
+	{
+		return moves;
+	}
+
+	for( unsigned int i = 0; i < moves; ++i )
+	{
+		pos.doMove(mg.getMoveFromMoveList(i));
+		tot += perftThread(pos, depth - 1);
+		pos.undoMove();
+	}
+
+	if( hashed )
+	{
+		tt.store(pos.getKey(), depth, tot);
+	}
+	return tot;
+}
@@ -0,0 +1,97 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef PERFT_H_
+#define PERFT_H_
+
+#include <atomic>
+#include <memory>
+#include "vajolet.h"
+#include "position.h"
+
+
+/*! \brief lock-free hash table of the perft subtree counts
+	each entry keeps the leaf count of a position at a given depth, the key is stored xored with the data
+	so that an entry torn by a concurrent store is seen as a miss
+*/
+class perftTranspositionTable
+{
+public:
+	/*! \brief allocate mbSize MB for the table, 0 disables it*/
+	void setSize(unsigned long int mbSize);
+
+	inline bool isEnabled(void) const
+	{
+		return (bool)table;
+	}
+
+	inline bool probe(const U64 key, const unsigned int depth, unsigned long long& count) const
+	{
+		const perftEntry& e = table[ key & mask ];
+		const U64 data = e.data.load(std::memory_order_relaxed);
+		if( ( e.keyCheck.load(std::memory_order_relaxed) ^ data ) == key && ( data & depthMask ) == depth )
+		{
+			count = data >> depthBits;
+			return true;
+		}
+		return false;
+	}
+
+	inline void store(const U64 key, const unsigned int depth, const unsigned long long count)
+	{
+		perftEntry& e = table[ key & mask ];
+		const U64 data = ( count << depthBits ) | depth;
+		e.data.store(data, std::memory_order_relaxed);
+		e.keyCheck.store(key ^ data, std::memory_order_relaxed);
+	}
+
+private:
+	struct perftEntry
+	{
+		std::atomic<U64> keyCheck;
+		std::atomic<U64> data;	/*!< leaf count in the upper bits, depth in the lower depthBits*/
+	};
+
+	static const unsigned int depthBits = 8;
+	static const U64 depthMask = ( 1ull << depthBits ) - 1;
+
+	std::unique_ptr<perftEntry[]> table;
+	U64 mask = 0;
+};
+
+/*! \brief perft with the root moves split between threads and an optional hash table of the subtree counts
+	leaf nodes are bulk counted: at depth 1 the number of legal moves is returned without playing them
+*/
+class Perft
+{
+public:
+	Perft(const Position& pos, unsigned int threads = 1, unsigned long int hashSizeMB = 0);
+	/*! \brief use a table shared with other perft calculations, the entries of different positions don't conflict*/
+	Perft(const Position& pos, unsigned int threads, perftTranspositionTable& table);
+
+	unsigned long long perft(unsigned int depth);
+
+private:
+	unsigned long long perftThread(Position& pos, unsigned int depth);
+
+	const Position& rootPosition;
+	unsigned int threads;
+	perftTranspositionTable ownTable;
+	perftTranspositionTable& tt;
+};
+
+#endif /* PERFT_H_ */
@@ -0,0 +1,407 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/*	perft suite runner
+
+	perftsuite <script> [-threads n] [-hash MB] [-maxdepth d] [-expected file] [-record file]
+
+	the script uses the UCI commands of the test/movegen files: a "position fen ..." line followed by "perft n" lines.
+	the script is read while the positions are searched: every thread takes the next position from the file, the threads
+	share one perft hash table and the results are printed (and recorded) in script order as soon as they are available.
+	-expected checks the counts against a reference file, -record writes one. the reference file has one line per position
+	in the perftsuite.epd format: "<fen> ;D1 <count> ;D2 <count> ..."
+	the exit code is 0 when all the checked counts match, 1 when a count is wrong and 2 for a bad command line or file.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vajolet.h"
+#include "io.h"
+#include "data.h"
+#include "hashKeys.h"
+#include "position.h"
+#include "movegen.h"
+#include "perft.h"
+
+
+struct perftJob
+{
+	std::string fen;
+	std::vector<unsigned int> depths;
+	std::vector<unsigned long long> results;
+	long long int time = 0;
+	bool done = false;
+};
+
+typedef std::map<std::string, std::map<unsigned int, unsigned long long>> expectedCounts;
+
+static const std::string startPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static std::string trim(const std::string& s)
+{
+	const size_t first = s.find_first_not_of(" \t\r\n");
+	if( first == std::string::npos )
+	{
+		return "";
+	}
+	const size_t last = s.find_last_not_of(" \t\r\n");
+	return s.substr(first, last - first + 1);
+}
+
+/*! \brief read the position and perft commands of an UCI script, one position at a time*/
+class scriptReader
+{
+public:
+	scriptReader(const unsigned int _maxDepth): maxDepth(_maxDepth){}
+
+	bool open(const std::string& fileName)
+	{
+		ifs.open(fileName);
+		if( !ifs.is_open() )
+		{
+			sync_cout << "cannot open " << fileName << sync_endl;
+			return false;
+		}
+		return true;
+	}
+
+	/*! \brief read the next position with the perft depths following it, false at the end of the script*/
+	bool read(perftJob& job)
+	{
+		std::string line;
+		while( !hasNextFen && std::getline(ifs, line) )
+		{
+			hasNextFen = parsePosition(line, nextFen);
+		}
+		if( !hasNextFen )
+		{
+			return false;
+		}
+		job.fen = nextFen;
+		hasNextFen = false;
+
+		while( std::getline(ifs, line) )
+		{
+			if( parsePosition(line, nextFen) )
+			{
+				hasNextFen = true;
+				break;
+			}
+			std::istringstream is(line);
+			std::string token;
+			unsigned int depth = 0;
+			if( ( is >> token ) && token == "perft" && ( is >> depth ) && depth > 0 && depth <= maxDepth )
+			{
+				job.depths.push_back(depth);
+			}
+		}
+		return true;
+	}
+
+private:
+	std::ifstream ifs;
+	const unsigned int maxDepth;
+	std::string nextFen;
+	bool hasNextFen = false;
+
+	static bool parsePosition(const std::string& line, std::string& fen)
+	{
+		std::istringstream is(line);
+		std::string token;
+		if( !( is >> token ) || token != "position" || !( is >> token ) )
+		{
+			return false;
+		}
+		if( token == "startpos" )
+		{
+			fen = startPosition;
+			return true;
+		}
+		if( token == "fen" )
+		{
+			std::getline(is, fen);
+			fen = trim(fen);
+			return true;
+		}
+		return false;
+	}
+};
+
+/*! \brief read a reference file in perftsuite.epd format*/
+static bool readExpected(const std::string& fileName, expectedCounts& expected)
+{
+	std::ifstream ifs(fileName);
+	if( !ifs.is_open() )
+	{
+		sync_cout << "cannot open " << fileName << sync_endl;
+		return false;
+	}
+
+	std::string line;
+	while( std::getline(ifs, line) )
+	{
+		std::istringstream is(line);
+		std::string field;
+		if( !std::getline(is, field, ';') || trim(field).empty() )
+		{
+			continue;
+		}
+		auto& counts = expected[ trim(field) ];
+		while( std::getline(is, field, ';') )
+		{
+			std::istringstream fs(field);
+			std::string depth;
+			unsigned long long count;
+			if( ( fs >> depth >> count ) && depth.size() > 1 && depth[0] == 'D' )
+			{
+				try
+				{
+					counts[ std::stoi( depth.substr(1) ) ] = count;
+				}
+				catch(...)
+				{
+					sync_cout << "bad depth " << depth << " in " << fileName << sync_endl;
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/*! \brief write the counts of a position in perftsuite.epd format*/
+static void writeExpected(std::ostream& os, const perftJob& job)
+{
+	os << job.fen;
+	for( unsigned int i = 0; i < job.depths.size(); ++i )
+	{
+		os << " ;D" << job.depths[i] << " " << job.results[i];
+	}
+	os << std::endl;
+}
+
+static double getMnps(unsigned long long nodes, long long int ms)
+{
+	return ms > 0 ? nodes / ( ms * 1000.0 ) : 0.0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string scriptFile;
+	std::string expectedFile;
+	std::string recordFile;
+	unsigned int threads = std::max( std::thread::hardware_concurrency(), 1u );
+	unsigned long int hashSize = 64;
+	unsigned int maxDepth = 100;
+
+	try
+	{
+		for( int i = 1; i < argc; ++i )
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if( arg == "-threads" && hasValue )
+			{
+				threads = std::max( std::stoi( argv[++i] ), 1 );
+			}
+			else if( arg == "-hash" && hasValue )
+			{
+				hashSize = std::max( std::stoi( argv[++i] ), 0 );
+			}
+			else if( arg == "-maxdepth" && hasValue )
+			{
+				maxDepth = std::max( std::stoi( argv[++i] ), 1 );
+			}
+			else if( arg == "-expected" && hasValue )
+			{
+				expectedFile = argv[++i];
+			}
+			else if( arg == "-record" && hasValue )
+			{
+				recordFile = argv[++i];
+			}
+			else if( scriptFile.empty() && arg[0] != '-' )
+			{
+				scriptFile = arg;
+			}
+			else
+			{
+				scriptFile.clear();
+				break;
+			}
+		}
+	}
+	catch(...)
+	{
+		// not a number
+		scriptFile.clear();
+	}
+	if( scriptFile.empty() )
+	{
+		sync_cout << "usage: perftsuite <script> [-threads n] [-hash MB] [-maxdepth d] [-expected file] [-record file]" << sync_endl;
+		return 2;
+	}
+
+	//----------------------------------
+	//	init global data
+	//----------------------------------
+	initData();
+	HashKeys::init();
+	Position::initScoreValues();
+	Position::initCastleRightsMask();
+	Movegen::initMovegenConstant();
+	Position::initMaterialKeys();
+
+	scriptReader script(maxDepth);
+	expectedCounts expected;
+	if( !script.open(scriptFile) || ( !expectedFile.empty() && !readExpected(expectedFile, expected) ) )
+	{
+		return 2;
+	}
+	std::ofstream record;
+	if( !recordFile.empty() )
+	{
+		record.open(recordFile);
+		if( !record.is_open() )
+		{
+			sync_cout << "cannot write " << recordFile << sync_endl;
+			return 2;
+		}
+	}
+
+	perftTranspositionTable table;
+	table.setSize(hashSize);
+
+	// jobs read from the script and not printed yet, in script order.
+	// the deque keeps the references to its elements valid when the ends change
+	std::deque<perftJob> jobs;
+	std::mutex jobMutex;
+	unsigned int printed = 0;
+	unsigned int checked = 0;
+	unsigned int failures = 0;
+	unsigned long long totalNodes = 0;
+
+	// print the finished jobs in script order and check them against the reference
+	auto printJobs = [&]()
+	{
+		while( !jobs.empty() && jobs.front().done )
+		{
+			const perftJob& job = jobs.front();
+			const auto exp = expected.find(job.fen);
+			unsigned long long nodes = 0;
+			for( unsigned int i = 0; i < job.depths.size(); ++i )
+			{
+				nodes += job.results[i];
+				if( exp != expected.end() )
+				{
+					const auto count = exp->second.find( job.depths[i] );
+					if( count != exp->second.end() )
+					{
+						++checked;
+						if( count->second != job.results[i] )
+						{
+							++failures;
+							sync_cout << "FAIL " << job.fen << " depth " << job.depths[i] << ": " << job.results[i] << " expected " << count->second << sync_endl;
+						}
+					}
+				}
+			}
+			totalNodes += nodes;
+			++printed;
+			sync_cout << printed << " " << job.fen << " : " << nodes << " nodes " << job.time << "ms " << std::fixed << std::setprecision(2) << getMnps(nodes, job.time) << " Mnps" << sync_endl;
+			if( record.is_open() )
+			{
+				writeExpected(record, job);
+			}
+			jobs.pop_front();
+		}
+	};
+
+	auto worker = [&]()
+	{
+		std::unique_ptr<Position> pos(new Position);
+		while( true )
+		{
+			perftJob* job;
+			{
+				std::lock_guard<std::mutex> lock(jobMutex);
+				jobs.emplace_back();
+				if( !script.read( jobs.back() ) )
+				{
+					jobs.pop_back();
+					return;
+				}
+				job = &jobs.back();
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			pos->setupFromFen(job->fen);
+			Perft pft(*pos, 1, table);
+			for( auto depth: job->depths )
+			{
+				job->results.push_back( pft.perft(depth) );
+			}
+			job->time = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start ).count();
+
+			std::lock_guard<std::mutex> lock(jobMutex);
+			job->done = true;
+			printJobs();
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for( unsigned int i = 1; i < threads; ++i )
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+	for( auto& t: pool )
+	{
+		t.join();
+	}
+	const long long int wallTime = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start ).count();
+
+	sync_cout << "===========================" << sync_endl;
+	sync_cout << "Positions       : " << printed << sync_endl;
+	sync_cout << "Threads         : " << threads << sync_endl;
+	sync_cout << "Hash (MB)       : " << hashSize << sync_endl;
+	sync_cout << "Total nodes     : " << totalNodes << sync_endl;
+	sync_cout << "Wall time (ms)  : " << wallTime << sync_endl;
+	sync_cout << "Mnps            : " << std::fixed << std::setprecision(2) << getMnps(totalNodes, wallTime) << sync_endl;
+	if( !expectedFile.empty() )
+	{
+		sync_cout << "Checked counts  : " << checked << ", failures " << failures << sync_endl;
+	}
+
+	if( record.is_open() && !record )
+	{
+		sync_cout << "cannot write " << recordFile << sync_endl;
+		return 2;
+	}
+	return failures ? 1 : 0;
+}
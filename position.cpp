@@ -306,10 +306,9 @@ void Position::setupFromFen(const std::string& fenStr)
 	x.pawnKey=calcPawnKey();
 	x.materialKey=calcMaterialKey();
 
-	calcCheckingSquares();
-
-	x.hiddenCheckersCandidate=getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(blackKing-x.nextMove)),x.nextMove);
-	x.pinnedPieces=getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove)),eNextMove(blackTurn-x.nextMove));
+	x.checkDataValid = false;
+	x.accumulatorComputed = false;
+	x.dirty.count = 0;
 	x.checkers= getAttackersTo(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))) & bitBoard[blackPieces-x.nextMove];
 
 
@@ -380,9 +379,8 @@ void Position::clear()
 	{
 		bitBoard[i] = 0;
 	}
-	stateInfo2.clear();
-	stateInfo2.emplace_back(state());
-	actualState = &stateInfo2.back();
+	actualState = &stateInfo2[0];
+	*actualState = state();
 
 }
 
@@ -757,10 +755,11 @@ simdScore Position::calcNonPawnMaterialValue() const
 void Position::doNullMove(void)
 {
 
-	insertState(getActualState());
+	insertState();
 	state &x = getActualState();
 
 	x.currentMove = 0;
+	x.dirty.count = 0;
 	if(x.epSquare != squareNone)
 	{
 		assert(x.epSquare<squareNumber);
@@ -779,11 +778,8 @@ void Position::doNullMove(void)
 	std::swap(Us,Them);
 
 
-	calcCheckingSquares();
-	assert(getSquareOfThePiece((bitboardIndex)(blackKing-x.nextMove))!=squareNone);
-	assert(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))!=squareNone);
-	x.hiddenCheckersCandidate = getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(blackKing-x.nextMove)),x.nextMove);
-	x.pinnedPieces = getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove)),eNextMove(blackTurn-x.nextMove));
+	x.checkDataValid = false;
+	x.accumulatorComputed = false;
 
 #ifdef	ENABLE_CHECK_CONSISTENCY
 	checkPosConsistency(1);
@@ -792,20 +788,43 @@ void Position::doNullMove(void)
 
 }
 /*! \brief do a move
+	\author STOCKFISH
+	\version 1.0
+	\version 1.1 colour templated body
+	\date 27/10/2013
+*/
+void Position::doMove(const Move & m)
+{
+	if( getNextTurn() == whiteTurn )
+	{
+		doColorMove<white>(m);
+	}
+	else
+	{
+		doColorMove<black>(m);
+	}
+}
+
+/*! \brief do a move of the side c, the side to move
 	\author STOCKFISH
 	\version 1.0
 	\date 27/10/2013
 */
-void Position::doMove(const Move & m){
+template<Color c>
+void Position::doColorMove(const Move & m){
 	//sync_cout<<displayUci(m)<<sync_endl;
 	assert(m.packed);
+	assert(getNextTurn() == ( c ? blackTurn : whiteTurn ));
+	const eNextMove us = c ? blackTurn : whiteTurn;
+	const eNextMove them = c ? whiteTurn : blackTurn;
 
 	bool moveIsCheck = moveGivesCheck(m);
 
-	insertState(getActualState());
+	insertState();
 	state &x = getActualState();
 
 	x.currentMove = m;
+	x.dirty.count = 0;
 
 
 
@@ -819,7 +838,7 @@ void Position::doMove(const Move & m){
 	assert(piece!=whitePieces);
 	assert(piece!=blackPieces);
 
-	bitboardIndex capture = ( m.isEnPassantMove() ? (x.nextMove?whitePawns:blackPawns) :squares[to]);
+	bitboardIndex capture = ( m.isEnPassantMove() ? (bitboardIndex)(whitePawns + them) :squares[to]);
 	assert(capture!=separationBitmap);
 	assert(capture!=whitePieces);
 	assert(capture!=blackPieces);
@@ -847,12 +866,12 @@ void Position::doMove(const Move & m){
 		bool kingSide = to > from;
 		tSquare rFrom = kingSide? to+est: to+ovest+ovest;
 		assert(rFrom<squareNumber);
-		bitboardIndex rook = squares[rFrom];
-		assert(rook<lastBitboard);
-		assert(isRook(rook));
+		const bitboardIndex rook = (bitboardIndex)(whiteRooks + us);
+		assert(squares[rFrom] == rook);
 		tSquare rTo = kingSide? to+ovest: to+est;
 		assert(rTo<squareNumber);
 		movePiece(rook,rFrom,rTo);
+		addDirtyPiece(x, rook, rFrom, rTo);
 		x.material += pstValue[rook][rTo] - pstValue[rook][rFrom];
 
 		//npm+=nonPawnValue[rook][rTo]-nonPawnValue[rook][rFrom];
@@ -870,7 +889,7 @@ void Position::doMove(const Move & m){
 
 			if( m.isEnPassantMove() )
 			{
-				captureSquare-=pawnPush(x.nextMove);
+				captureSquare-=pawnPush(c);
 			}
 			assert(captureSquare<squareNumber);
 			x.pawnKey ^= HashKeys::keys[captureSquare][capture];
@@ -880,6 +899,7 @@ void Position::doMove(const Move & m){
 
 		// remove piece
 		removePiece(capture,captureSquare);
+		addDirtyPiece(x, capture, captureSquare, squareNone);
 		// update material
 		x.material -= pstValue[capture][captureSquare];
 
@@ -895,6 +915,7 @@ void Position::doMove(const Move & m){
 	// update hashKey
 	x.key ^= HashKeys::keys[from][piece] ^ HashKeys::keys[to][piece];
 	movePiece(piece,from,to);
+	addDirtyPiece(x, piece, from, to);
 
 	x.material += pstValue[piece][to] - pstValue[piece][from];
 	//npm+=nonPawnValue[piece][to]-nonPawnValue[piece][from];
@@ -918,7 +939,7 @@ void Position::doMove(const Move & m){
 	{
 		if(
 				abs(from-to)==16
-				&& (getAttackersTo((tSquare)((from+to)>>1))  & Them[Pawns])
+				&& (Movegen::attackFrom<c ? blackPawns : whitePawns>((tSquare)((from+to)>>1)) & bitBoard[whitePawns + them])
 		)
 		{
 			x.epSquare = (tSquare)((from+to)>>1);
@@ -927,10 +948,12 @@ void Position::doMove(const Move & m){
 		}
 		if( m.isPromotionMove() )
 		{
-			bitboardIndex promotedPiece = (bitboardIndex)(whiteQueens + x.nextMove + m.bit.promotion);
+			bitboardIndex promotedPiece = (bitboardIndex)(whiteQueens + us + m.bit.promotion);
 			assert(promotedPiece<lastBitboard);
 			removePiece(piece,to);
 			putPiece(promotedPiece,to);
+			x.dirty.to[ x.dirty.count - 1 ] = squareNone;
+			addDirtyPiece(x, promotedPiece, squareNone, to);
 
 			x.material += pstValue[promotedPiece][to]-pstValue[piece][to];
 			x.nonPawnMaterial += nonPawnValue[promotedPiece]/*[to]*/;
@@ -947,7 +970,7 @@ void Position::doMove(const Move & m){
 	x.capturedPiece = capture;
 
 
-	x.nextMove = (eNextMove)(blackTurn-x.nextMove);
+	x.nextMove = them;
 
 
 
@@ -960,12 +983,13 @@ void Position::doMove(const Move & m){
 
 		if(m.bit.flags != Move::fnone)
 		{
-			assert(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))<squareNumber);
-			x.checkers |= getAttackersTo(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))) & Them[Pieces];
+			assert(getSquareOfThePiece((bitboardIndex)(whiteKing + them))<squareNumber);
+			x.checkers |= getAttackersTo(getSquareOfThePiece((bitboardIndex)(whiteKing + them))) & bitBoard[whitePieces + us];
 		}
 		else
 		{
-			if(x.checkingSquares[piece] & bitSet(to)) // should be old state, but checkingSquares has not been changed so far
+			assert(x.checkDataValid);	// copied from the old state, moveGivesCheck has already calculated it
+			if(x.getCheckingSquares(piece) & bitSet(to)) // should be old state, but checkingSquares has not been changed so far
 			{
 				x.checkers |= bitSet(to);
 			}
@@ -973,23 +997,20 @@ void Position::doMove(const Move & m){
 			{
 				if(!isRook(piece))
 				{
-					assert(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))<squareNumber);
-					x.checkers |= Movegen::attackFrom<Position::whiteRooks>(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove)),bitBoard[occupiedSquares]) & (Them[Queens] |Them[Rooks]);
+					assert(getSquareOfThePiece((bitboardIndex)(whiteKing + them))<squareNumber);
+					x.checkers |= Movegen::attackFrom<Position::whiteRooks>(getSquareOfThePiece((bitboardIndex)(whiteKing + them)),bitBoard[occupiedSquares]) & (bitBoard[whiteQueens + us] | bitBoard[whiteRooks + us]);
 				}
 				if(!isBishop(piece))
 				{
-					assert(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))<squareNumber);
-					x.checkers |= Movegen::attackFrom<Position::whiteBishops>(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove)),bitBoard[occupiedSquares]) & (Them[Queens] |Them[Bishops]);
+					assert(getSquareOfThePiece((bitboardIndex)(whiteKing + them))<squareNumber);
+					x.checkers |= Movegen::attackFrom<Position::whiteBishops>(getSquareOfThePiece((bitboardIndex)(whiteKing + them)),bitBoard[occupiedSquares]) & (bitBoard[whiteQueens + us] | bitBoard[whiteBishops + us]);
 				}
 			}
 		}
 	}
 
-	calcCheckingSquares();
-	assert(getSquareOfThePiece((bitboardIndex)(blackKing-x.nextMove))<squareNumber);
-	x.hiddenCheckersCandidate=getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(blackKing-x.nextMove)),x.nextMove);
-	assert(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove))<squareNumber);
-	x.pinnedPieces = getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(whiteKing+x.nextMove)),eNextMove(blackTurn-x.nextMove));
+	x.checkDataValid = false;
+	x.accumulatorComputed = false;
 
 #ifdef	ENABLE_CHECK_CONSISTENCY
 	checkPosConsistency(1);
@@ -1001,15 +1022,36 @@ void Position::doMove(const Move & m){
 /*! \brief undo a move
 	\author STOCKFISH
 	\version 1.0
+	\version 1.1 colour templated body
 	\date 27/10/2013
 */
 void Position::undoMove()
 {
+	// the move to undo has been played by the side not to move
+	if( getNextTurn() == whiteTurn )
+	{
+		undoColorMove<black>();
+	}
+	else
+	{
+		undoColorMove<white>();
+	}
+}
+
+/*! \brief undo a move played by the side c
+	\author STOCKFISH
+	\version 1.0
+	\date 27/10/2013
+*/
+template<Color c>
+void Position::undoColorMove()
+{
+	const eNextMove us = c ? blackTurn : whiteTurn;
 
 	--ply;
 
-	state x = getActualStateConst();
-	Move &m = x.currentMove;
+	const state& x = getActualStateConst();
+	const Move &m = x.currentMove;
 	assert(m.packed);
 	tSquare to = (tSquare)m.bit.to;
 	tSquare from = (tSquare)m.bit.from;
@@ -1021,7 +1063,7 @@ void Position::undoMove()
 
 	if( m.isPromotionMove() ){
 		removePiece(piece,to);
-		piece = (bitboardIndex)(piece > separationBitmap ? blackPawns : whitePawns);
+		piece = (bitboardIndex)(whitePawns + us);
 		putPiece(piece,to);
 	}
 
@@ -1032,9 +1074,8 @@ void Position::undoMove()
 		tSquare rTo = kingSide? to+ovest: to+est;
 		assert(rFrom<squareNumber);
 		assert(rTo<squareNumber);
-		bitboardIndex rook = squares[rTo];
-		assert(rook<lastBitboard);
-		assert(isRook(rook));
+		const bitboardIndex rook = (bitboardIndex)(whiteRooks + us);
+		assert(squares[rTo] == rook);
 		movePiece(rook,rTo,rFrom);
 
 	}
@@ -1047,7 +1088,7 @@ void Position::undoMove()
 	{
 		tSquare capSq = to;
 		if( m.isEnPassantMove() ){
-			capSq += pawnPush(x.nextMove);
+			capSq -= pawnPush(c);
 		}
 		assert(capSq<squareNumber);
 		putPiece(x.capturedPiece,capSq);
@@ -1320,14 +1361,16 @@ unsigned long long Position::divide(unsigned int depth)
 }
 
 
-/*! \brief calculate the checking squares given the king position
+/*! \brief calculate the checking squares given the king position, the discover check candidates and the pinned pieces of the actual state
 	\author Marco Belli
 	\version 1.0
+	\version 1.1 lazy calculation
 	\date 08/11/2013
 */
-inline void Position::calcCheckingSquares(void)
+void Position::calcCheckData(void) const
 {
-	state &s = getActualState();
+	// the check data is a cache of the actual state, it can be filled from const methods
+	state &s = *actualState;
 	bitboardIndex opponentKing = (bitboardIndex)(blackKing-s.nextMove);
 	assert(opponentKing<lastBitboard);
 	bitboardIndex attackingPieces = (bitboardIndex)(s.nextMove);
@@ -1338,29 +1381,28 @@ inline void Position::calcCheckingSquares(void)
 
 	bitMap occupancy = bitBoard[occupiedSquares];
 
-	s.checkingSquares[whiteKing+attackingPieces]=0;
+	// only the pieces of the active player can give check, the array is indexed by piece type
+	s.checkingSquares[occupiedSquares] = 0;
+	s.checkingSquares[King] = 0;
 	assert(kingSquare<squareNumber);
-	assert(whitePawns+attackingPieces<lastBitboard);
-	s.checkingSquares[whiteRooks+attackingPieces] = Movegen::attackFrom<Position::whiteRooks>(kingSquare,occupancy);
-	s.checkingSquares[whiteBishops+attackingPieces] = Movegen::attackFrom<Position::whiteBishops>(kingSquare,occupancy);
-	s.checkingSquares[whiteQueens+attackingPieces] = s.checkingSquares[whiteRooks+attackingPieces]|s.checkingSquares[whiteBishops+attackingPieces];
-	s.checkingSquares[whiteKnights+attackingPieces] = Movegen::attackFrom<Position::whiteKnights>(kingSquare);
+	s.checkingSquares[Rooks] = Movegen::attackFrom<Position::whiteRooks>(kingSquare,occupancy);
+	s.checkingSquares[Bishops] = Movegen::attackFrom<Position::whiteBishops>(kingSquare,occupancy);
+	s.checkingSquares[Queens] = s.checkingSquares[Rooks]|s.checkingSquares[Bishops];
+	s.checkingSquares[Knights] = Movegen::attackFrom<Position::whiteKnights>(kingSquare);
 
 	if(attackingPieces)
 	{
-		s.checkingSquares[whitePawns+attackingPieces] = Movegen::attackFrom<Position::whitePawns>(kingSquare);
+		s.checkingSquares[Pawns] = Movegen::attackFrom<Position::whitePawns>(kingSquare);
 	}else
 	{
-		s.checkingSquares[whitePawns+attackingPieces] = Movegen::attackFrom<Position::blackPawns>(kingSquare,1);
+		s.checkingSquares[Pawns] = Movegen::attackFrom<Position::blackPawns>(kingSquare,1);
 	}
+	s.checkingSquares[Pieces] = 0;
 
-	assert(blackPawns-attackingPieces>=0);
-	s.checkingSquares[blackKing-attackingPieces] = 0;
-	s.checkingSquares[blackRooks-attackingPieces] = 0;
-	s.checkingSquares[blackBishops-attackingPieces] = 0;
-	s.checkingSquares[blackQueens-attackingPieces] = 0;
-	s.checkingSquares[blackKnights-attackingPieces] = 0;
-	s.checkingSquares[blackPawns-attackingPieces]  =0;
+	s.hiddenCheckersCandidate = getHiddenCheckers(kingSquare,s.nextMove);
+	assert(getSquareOfThePiece((bitboardIndex)(whiteKing+s.nextMove))<squareNumber);
+	s.pinnedPieces = getHiddenCheckers(getSquareOfThePiece((bitboardIndex)(whiteKing+s.nextMove)),eNextMove(blackTurn-s.nextMove));
+	s.checkDataValid = true;
 
 }
 
@@ -1425,10 +1467,10 @@ bool Position::moveGivesCheck(const Move& m)const
 	assert(piece!=separationBitmap);
 	assert(piece!=whitePieces);
 	assert(piece!=blackPieces);
-	const state &s = getActualStateConst();
+	const state &s = getCheckData();
 
 	// Direct check ?
-	if (s.checkingSquares[piece] & bitSet(to))
+	if (s.getCheckingSquares(piece) & bitSet(to))
 	{
 		return true;
 	}
@@ -1454,7 +1496,7 @@ bool Position::moveGivesCheck(const Move& m)const
 	case Move::fpromotion:
 	{
 		assert((bitboardIndex)(whiteQueens+s.nextMove+m.bit.promotion)<lastBitboard);
-		if (s.checkingSquares[whiteQueens+s.nextMove+m.bit.promotion] & bitSet(to))
+		if (s.getCheckingSquares((bitboardIndex)(whiteQueens+s.nextMove+m.bit.promotion)) & bitSet(to))
 		{
 			return true;
 		}
@@ -1519,11 +1561,11 @@ bool Position::moveGivesDoubleCheck(const Move& m)const
 	assert(piece!=separationBitmap);
 	assert(piece!=whitePieces);
 	assert(piece!=blackPieces);
-	const state &s = getActualStateConst();
+	const state &s = getCheckData();
 
 
 	// Direct check ?
-	return ((s.checkingSquares[piece] & bitSet(to)) && (s.hiddenCheckersCandidate && (s.hiddenCheckersCandidate & bitSet(from))));
+	return ((s.getCheckingSquares(piece) & bitSet(to)) && (s.hiddenCheckersCandidate && (s.hiddenCheckersCandidate & bitSet(from))));
 
 
 }
@@ -1538,10 +1580,10 @@ bool Position::moveGivesSafeDoubleCheck(const Move& m)const
 	assert(piece!=separationBitmap);
 	assert(piece!=whitePieces);
 	assert(piece!=blackPieces);
-	const state & s=getActualStateConst();
+	const state & s=getCheckData();
 
 	tSquare kingSquare = getSquareOfThePiece((bitboardIndex)(blackKing-s.nextMove));
-	return (!(Movegen::attackFrom<Position::whiteKing>(kingSquare) & bitSet(to)) &&  (s.checkingSquares[piece] & bitSet(to)) && (s.hiddenCheckersCandidate && (s.hiddenCheckersCandidate & bitSet(from))));
+	return (!(Movegen::attackFrom<Position::whiteKing>(kingSquare) & bitSet(to)) &&  (s.getCheckingSquares(piece) & bitSet(to)) && (s.hiddenCheckersCandidate && (s.hiddenCheckersCandidate & bitSet(from))));
 
 
 }
@@ -1578,17 +1620,17 @@ bool Position::isDraw(bool isPVline) const
 	// Draw by repetition?
 	unsigned int counter=1;
 	U64 actualkey = getActualStateConst().key;
-	auto it = stateInfo2.rbegin();
+	const state* it = actualState;
 	
 
 	int e = std::min(getActualStateConst().fiftyMoveCnt, getActualStateConst().pliesFromNull);
 	if( e >= 4)
 	{
-		std::advance( it,2);
+		it -= 2;
 	}
 	for(int i = 4 ;	i<=e;i+=2)
 	{
-		std::advance( it,2);
+		it -= 2;
 		if(it->key == actualkey)
 		{
 			counter++;
@@ -1655,7 +1697,7 @@ bool Position::isMoveLegal(const Move &m)const
 			}
 		}
 	}
-	if(((s.pinnedPieces & bitSet((tSquare)m.bit.from)) && !squaresAligned((tSquare)m.bit.from,(tSquare)m.bit.to,getSquareOfThePiece((bitboardIndex)(whiteKing+s.nextMove)))))
+	if(((getPinnedPieces() & bitSet((tSquare)m.bit.from)) && !squaresAligned((tSquare)m.bit.from,(tSquare)m.bit.to,getSquareOfThePiece((bitboardIndex)(whiteKing+s.nextMove)))))
 	{
 		return false;
 	}
@@ -27,6 +27,7 @@
 #include "io.h"
 #include "tables.h"
 #include "bitops.h"
+#include "nnue.h"
 
 
 
@@ -45,21 +46,6 @@ typedef enum
 
 class Position
 {
-	struct materialStruct
-	{
-		typedef enum
-		{
-			exact,
-			multiplicativeFunction,
-			exactFunction,
-			saturationH,
-			saturationL,
-		} tType ;
-		tType type;
-		bool (Position::*pointer)(Score &);
-		Score val;
-
-	};
 public:
 	void static initMaterialKeys(void);
 
@@ -127,9 +113,9 @@ public:
 	*/
 	Position()
 	{		
-		stateInfo2.clear();
-		stateInfo2.emplace_back(state());
-		actualState = &stateInfo2.back();
+		stateInfo2.resize(STATE_INFO_LENGTH);
+		actualState = &stateInfo2[0];
+		*actualState = state();
 
 		
 		actualState->nextMove = whiteTurn;
@@ -141,8 +127,7 @@ public:
 
 	Position(const Position& other)// calls the copy constructor of the age
 	{
-		stateInfo2 = other.stateInfo2;
-		actualState = &stateInfo2.back();
+		copyStates(other);
 
 		
 		
@@ -165,8 +150,7 @@ public:
 		if (this == &other)
 			return *this;
 
-		stateInfo2 = other.stateInfo2;
-		actualState = &stateInfo2.back();
+		copyStates(other);
 		
 
 		for(int i = 0; i < squareNumber; i++)
@@ -209,16 +193,27 @@ public:
 		bitboardIndex capturedPiece; /*!<  index of the captured piece for unmakeMove*/
 		//Score material[2];	/*!<  two values for opening/endgame score*/
 		simdScore material;
-		bitMap checkingSquares[lastBitboard]; /*!< squares of the board from where a king can be checked*/
+		bitMap checkingSquares[separationBitmap]; /*!< squares of the board from where a piece of the active player can give check, indexed by piece type*/
 		bitMap hiddenCheckersCandidate;	/*!< pieces who can make a discover check moving*/
 		bitMap pinnedPieces;	/*!< pinned pieces*/
 		bitMap checkers;	/*!< checking pieces*/
 		Move currentMove;
+		bool checkDataValid;	/*!< checkingSquares, hiddenCheckersCandidate and pinnedPieces have been calculated, see Position::getCheckData*/
+		bool accumulatorComputed;	/*!< the nnue accumulator of this state is up to date, see Position::evalNnue*/
+		dirtyPieces dirty;	/*!< pieces changed by the move that led to this state*/
 
-		state()
+		state(): key(0), pawnKey(0), materialKey(0), nonPawnMaterial(), nextMove(whiteTurn), castleRights((eCastle)0), epSquare(squareNone),
+			fiftyMoveCnt(0), pliesFromNull(0), capturedPiece(empty), material(), checkingSquares(), hiddenCheckersCandidate(0), pinnedPieces(0), checkers(0),
+			currentMove(0), checkDataValid(false), accumulatorComputed(false), dirty()
 		{
 		}
 
+		/*! \brief squares from where a piece of the active player gives check to the opponent king*/
+		inline bitMap getCheckingSquares(const bitboardIndex piece) const
+		{
+			return checkingSquares[ piece & ( separationBitmap - 1 ) ];
+		}
+
 
 	};
 
@@ -239,11 +234,34 @@ private:
 
 
 	/*used for search*/
-	pawnTable pawnHashTable;
+	pawnTable* pawnHashTable = nullptr;	/*!< table of the searching thread, not copied with the position. without it the pawns are evaluated every time*/
+	materialTable* materialHashTable = nullptr;	/*!< table of the searching thread, like pawnHashTable*/
 	state* actualState;
 
+	/*! \brief stack of the states: the game history followed by the states of the search
+		the storage always leaves room for STATE_INFO_LENGTH new states and it is never shrunk, so doMove/undoMove don't allocate or move it
+	*/
 	std::vector<state> stateInfo2;
 
+	/*! \brief nnue accumulators of the states, same indexes of stateInfo2. allocated the first time the network is used*/
+	std::vector<nnueAccumulator> accumulators;
+
+	/*! \brief copy the states in use of another position, the accumulators are not copied*/
+	inline void copyStates(const Position& other)
+	{
+		const unsigned int used = other.getStateSize();
+		if( stateInfo2.size() < used + STATE_INFO_LENGTH )
+		{
+			stateInfo2.resize( used + STATE_INFO_LENGTH );
+		}
+		std::copy( other.stateInfo2.begin(), other.stateInfo2.begin() + used, stateInfo2.begin() );
+		actualState = &stateInfo2[ used - 1 ];
+		for( unsigned int i = 0; i < used; ++i )
+		{
+			stateInfo2[i].accumulatorComputed = false;
+		}
+	}
+
 
 	/*! \brief board rapresentation
 		\author Marco Belli
@@ -289,7 +307,7 @@ public:
 
 	unsigned int getStateSize() const
 	{
-		return stateInfo2.size();
+		return (unsigned int)( actualState - stateInfo2.data() ) + 1;
 	}
 	//unsigned int getStateIndex(void)const { return 0;}
 
@@ -312,6 +330,16 @@ public:
 	std::string getSymmetricFen() const;
 
 	void setupFromFen(const std::string& fenStr);
+	/*! \brief use the pawn hash table of a search thread, it shall live as long as the position*/
+	void setPawnTable(pawnTable* table)
+	{
+		pawnHashTable = table;
+	}
+	/*! \brief use the material hash table of a search thread, it shall live as long as the position*/
+	void setMaterialTable(materialTable* table)
+	{
+		materialHashTable = table;
+	}
 	void setup(const std::string& code, Color c);
 
 	unsigned long long perft(unsigned int depth);
@@ -338,6 +366,7 @@ public:
 
 
 	template<bool trace>Score eval(void);
+	Score evalNnue(void);
 	bool isDraw(bool isPVline) const;
 
 
@@ -455,6 +484,12 @@ public:
 		return getActualStateConst().checkers;
 	}
 
+	/*! \brief return the pieces of the active player pinned to their king*/
+	bitMap getPinnedPieces(void) const
+	{
+		return getCheckData().pinnedPieces;
+	}
+
 
 
 
@@ -482,16 +517,24 @@ public:
 
 private:
 
-	/*! \brief insert a new state in memory
+	/*! \brief push a copy of the actual state on the stack
 		\author Marco Belli
 		\version 1.0
 		\version 1.1 get rid of continuos malloc/free
+		\version 1.2 preallocated stack
 		\date 21/11/2013
 	*/
-	inline void insertState(state & s)
+	inline void insertState()
 	{
-		stateInfo2.emplace_back(s);
-		actualState = &stateInfo2.back();
+		if( actualState == &stateInfo2.back() )
+		{
+			// only a very long game can get here, never during the search
+			const unsigned int used = getStateSize();
+			stateInfo2.resize( used + STATE_INFO_LENGTH );
+			actualState = &stateInfo2[ used - 1 ];
+		}
+		*( actualState + 1 ) = *actualState;
+		++actualState;
 	}
 
 	/*! \brief  remove the last state
@@ -502,8 +545,8 @@ private:
 	*/
 	inline void removeState()
 	{
-		stateInfo2.pop_back();
-		actualState = &stateInfo2.back();
+		assert( actualState > stateInfo2.data() );
+		--actualState;
 	}
 
 
@@ -598,9 +641,34 @@ private:
 	simdScore calcNonPawnMaterialValue(void) const;
 	bool checkPosConsistency(int nn) const;
 	void clear();
-	inline void calcCheckingSquares(void);
+	template<Color c> void doColorMove(const Move &m);
+	template<Color c> void undoColorMove();
+	void calcCheckData(void) const;
+	void calcAccumulator(const unsigned int index);
+
+	inline static void addDirtyPiece(state& x, const bitboardIndex piece, const tSquare from, const tSquare to)
+	{
+		assert( x.dirty.count < dirtyPieces::maxPieces );
+		const unsigned int n = x.dirty.count++;
+		x.dirty.piece[n] = piece;
+		x.dirty.from[n] = from;
+		x.dirty.to[n] = to;
+	}
 	bitMap getHiddenCheckers(tSquare kingSquare,eNextMove next) const;
 
+	/*! \brief return the actual state with its check data calculated
+		doMove and doNullMove don't calculate checking squares, discover check candidates and pinned pieces, they are calculated the first time they are needed,
+		so a node cut off before generating or checking any move doesn't pay for them.
+	*/
+	inline const state& getCheckData(void) const
+	{
+		if( !actualState->checkDataValid )
+		{
+			calcCheckData();
+		}
+		return *actualState;
+	}
+
 
 
 
@@ -687,7 +755,8 @@ private:
 
 	std::unordered_map<U64, materialStruct> static materialKeyMap;
 
-	const materialStruct  * getMaterialData();
+	void calcMaterialEntry(materialEntry& entry) const;
+	const materialEntry& getMaterialEntry(materialEntry& buffer);
 	bool evalKxvsK(Score& res);
 	bool evalKBPsvsK(Score& res);
 	bool evalKQvsKP(Score& res);
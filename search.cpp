@@ -20,6 +20,9 @@
 
 #include <vector>
 #include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <algorithm>    // std::copy
 #include <iterator>     // std::back_inserter
 #include "search.h"
@@ -57,9 +60,132 @@ bool Search::showCurrentLine = false;
 std::string Search::SyzygyPath ="<empty>";
 unsigned int Search::SyzygyProbeDepth = 1;
 bool Search::Syzygy50MoveRule= true;
+bool Search::recordVisitedPositions = false;
+bool Search::silentOutput = false;
+unsigned int Search::evalCacheSize = 1;
+unsigned int Search::pawnHashSize = 1;
 
 static std::vector<Search> helperSearch;
 
+/*! \brief long lived lazy smp helper threads
+	the threads are created once, parked on a condition variable and receive a new job (depth, window) at every iteration of the main search.
+	helper i searches helperSearch[i].
+*/
+class helperThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	unsigned long long jobId = 0;
+	unsigned int running = 0;
+	bool quit = false;
+
+	int jobDepth = 0;
+	Score jobAlpha = -SCORE_INFINITE;
+	Score jobBeta = SCORE_INFINITE;
+
+	void idleLoop(unsigned int i, unsigned long long lastJob);
+	void shutdown();
+
+public:
+	~helperThreadPool()
+	{
+		shutdown();
+	}
+
+	void resize(unsigned int n);
+	void startJob(int depth, Score alpha, Score beta);
+	void waitJob();
+};
+
+static helperThreadPool helperPool;
+
+void helperThreadPool::idleLoop(unsigned int i, unsigned long long lastJob)
+{
+	while(true)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		startCondition.wait(lock, [&]{ return quit || jobId != lastJob; });
+		if( quit )
+		{
+			return;
+		}
+		lastJob = jobId;
+		const int depth = jobDepth;
+		const Score alpha = jobAlpha;
+		const Score beta = jobBeta;
+		lock.unlock();
+
+		PVline pvl;
+		helperSearch[i].alphaBeta<Search::nodeType::HELPER_ROOT_NODE>(0, (depth+((i+1)%2))*ONE_PLY, alpha, beta, pvl);
+
+		lock.lock();
+		if( --running == 0 )
+		{
+			doneCondition.notify_one();
+		}
+	}
+}
+
+void helperThreadPool::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	startCondition.notify_all();
+	for(auto& t: workers)
+	{
+		t.join();
+	}
+	workers.clear();
+	quit = false;
+}
+
+/*! \brief set the number of helper threads, the pool is rebuilt only when the number changes*/
+void helperThreadPool::resize(unsigned int n)
+{
+	if( n == workers.size() && n == helperSearch.size() )
+	{
+		return;
+	}
+	shutdown();
+
+	// Search is not movable, the helpers are built in place
+	std::vector<Search>(n).swap(helperSearch);
+	for(unsigned int i = 0; i < n; i++)
+	{
+		workers.emplace_back(&helperThreadPool::idleLoop, this, i, jobId);
+	}
+}
+
+/*! \brief wake up all the helpers, their position and PV shall be already set*/
+void helperThreadPool::startJob(int depth, Score alpha, Score beta)
+{
+	if( workers.empty() )
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobDepth = depth;
+		jobAlpha = alpha;
+		jobBeta = beta;
+		running = workers.size();
+		jobId++;
+	}
+	startCondition.notify_all();
+}
+
+/*! \brief wait for all the helpers to finish the current job*/
+void helperThreadPool::waitJob()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [&]{ return running == 0; });
+}
+
 unsigned long long Search::getVisitedNodes() const
 {
 	unsigned long long n = visitedNodes;
@@ -76,6 +202,66 @@ unsigned long long Search::getTbHits() const
 	return n;
 }
 
+evalCacheStats Search::getEvalCacheStats() const
+{
+	evalCacheStats s = { evalCache.getProbes(), evalCache.getHits() };
+	for (auto& hs : helperSearch)
+	{
+		s.probes += hs.evalCache.getProbes();
+		s.hits += hs.evalCache.getHits();
+	}
+	return s;
+}
+
+/*! \brief sorted keys without duplicates*/
+static std::vector<U64> uniqueKeys(std::vector<U64> keys)
+{
+	std::sort( keys.begin(), keys.end() );
+	keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+	return keys;
+}
+
+/*! \brief compare the positions visited by the helpers with the ones visited by the main thread, needs recordVisitedPositions*/
+duplicatedNodes Search::getDuplicatedNodes() const
+{
+	duplicatedNodes res = { 0, 0 };
+	if( !recordVisitedPositions || helperSearch.empty() )
+	{
+		return res;
+	}
+	std::vector<U64> helperKeys;
+	for (auto& hs : helperSearch)
+	{
+		helperKeys.insert( helperKeys.end(), hs.visited.getKeys().begin(), hs.visited.getKeys().end() );
+	}
+	helperKeys = uniqueKeys( std::move(helperKeys) );
+	const std::vector<U64> mainKeys = uniqueKeys( visited.getKeys() );
+
+	res.helperPositions = helperKeys.size();
+	auto m = mainKeys.begin();
+	for( const auto k: helperKeys )
+	{
+		m = std::lower_bound( m, mainKeys.end(), k );
+		if( m == mainKeys.end() )
+		{
+			break;
+		}
+		if( *m == k )
+		{
+			++res.duplicated;
+		}
+	}
+	return res;
+}
+
+void Search::pollNodeLimit()
+{
+	if( mainSearcher && limits.nodes && ( visitedNodes % nodeLimitPollInterval ) == 0 && my_thread::timeMan.FirstIterationFinished && getVisitedNodes() >= limits.nodes )
+	{
+		stop = true;
+	}
+}
+
 
 startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 {
@@ -93,9 +279,14 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 	visitedNodes = 0;
 	tbHits = 0;
 	mainSearcher = true;
+	evalCache.setSize(evalCacheSize);
+	pawnHash.setSize(pawnHashSize);
+	if( recordVisitedPositions )
+	{
+		visited.clear();
+	}
 
-	helperSearch.clear();
-	helperSearch.resize(threads-1);
+	helperPool.resize(threads-1);
 
 	for (auto& hs : helperSearch)
 	{
@@ -105,6 +296,12 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 		hs.visitedNodes = 0;
 		hs.tbHits = 0;
 		hs.mainSearcher = false;
+		hs.evalCache.setSize(evalCacheSize);
+		hs.pawnHash.setSize(pawnHashSize);
+		if( recordVisitedPositions )
+		{
+			hs.visited.clear();
+		}
 	}
 
 
@@ -240,7 +437,10 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 
 		PVline newPV;
 		Score res =qsearch<Search::nodeType::PV_NODE>(0, 0, -SCORE_INFINITE,SCORE_INFINITE, newPV);
-		sync_cout<<"info score cp "<<int(res/100)<<sync_endl;
+		if( !silentOutput )
+		{
+			sync_cout<<"info score cp "<<int(res/100)<<sync_endl;
+		}
 
 		startThinkResult ret;
 		ret.PV = newPV;
@@ -259,11 +459,13 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 
 	//Score alpha = -SCORE_INFINITE, beta = SCORE_INFINITE;
 	Score delta = 800;
-	Move oldBestMove(Movegen::NOMOVE);
 
 	do
 	{
-		sync_cout<<"info depth "<<depth<<sync_endl;
+		if( !silentOutput )
+		{
+			sync_cout<<"info depth "<<depth<<sync_endl;
+		}
 		//----------------------------
 		// iterative loop
 		//----------------------------
@@ -319,18 +521,16 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 				// multithread : lazy smp threads
 				//----------------------------
 
-				std::vector<PVline> pvl2(threads-1);
-				std::vector<std::thread> helperThread;
 
-				// launch helper threads
+				// prepare and wake up the helper threads
 				for(unsigned int i = 0; i < (threads - 1); i++)
 				{
 					helperSearch[i].stop = false;
 					helperSearch[i].pos = pos;
 					helperSearch[i].PV = PV;
 					helperSearch[i].followPV = true;
- 					helperThread.emplace_back( std::thread(&Search::alphaBeta<Search::nodeType::HELPER_ROOT_NODE>, &helperSearch[i], 0, (depth-globalReduction+((i+1)%2))*ONE_PLY, alpha, beta, std::ref(pvl2[i])));
 				}
+				helperPool.startJob(depth-globalReduction, alpha, beta);
 
 				newPV.clear();
 				// main thread
@@ -341,10 +541,7 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 				{
 					helperSearch[i].stop = true;
 				}
-				for(auto &t : helperThread)
-				{
-					t.join();
-				}
+				helperPool.waitJob();
 
 				// don't stop befor having finished at least one iteration
 				/*if(depth != 1 && stop)
@@ -395,7 +592,7 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 					if (res <= alpha)
 					{
 						newPV.clear();
-						newPV.emplace_back( rootMoves[indexPV].PV.front() );
+						newPV.emplace_back( rootMoves[indexPV].firstMove );
 
 						printPV(res, depth, maxPlyReached, alpha, beta, elapsedTime, indexPV, newPV, getVisitedNodes());
 
@@ -447,15 +644,10 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 			}
 		}
 
-		//------------------------------------------------
-		// check wheter or not the new best move has changed
-		//------------------------------------------------
-		oldBestMove = newPV.front();
-
-
 		my_thread::timeMan.idLoopIterationFinished = true;
 		my_thread::timeMan.idLoopAlpha = false;
 		my_thread::	timeMan.idLoopBeta = false;
+		my_thread::wakeUpTimer();
 		depth += 1;
 
 	}
@@ -464,6 +656,11 @@ startThinkResult Search::startThinking(int depth, Score alpha, Score beta)
 
 	startThinkResult ret;
 	ret.PV = rootMoves[0].PV;
+	// stopped before the first iteration has found a line: answer with a legal move
+	if( ret.PV.size() == 0 )
+	{
+		ret.PV.emplace_back( rootMoves[0].firstMove );
+	}
 	ret.depth = depth-1;
 	ret.alpha = alpha;
 	ret.beta = beta;
@@ -486,7 +683,8 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 
 
 	const Position::state& st = pos.getActualState();
-	visitedNodes++;
+	countNode();
+	pollNodeLimit();
 	clearKillers(ply+1);
 
 	const bool PVnode = ( type == Search::nodeType::PV_NODE || type == Search::nodeType::ROOT_NODE  || type == Search::nodeType::HELPER_ROOT_NODE);
@@ -542,19 +740,20 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 	//--------------------------------------
 	// test the transposition table
 	//--------------------------------------
-	ttEntry* tte = TT.probe(posKey);
-	Move ttMove = tte->getPackedMove();
-	Score ttValue = transpositionTable::scoreFromTT(tte->getValue(), ply);
+	ttEntry tte = TT.probe(posKey);
+	Move ttMove = tte.getPackedMove();
+	Score ttValue = transpositionTable::scoreFromTT(tte.getValue(), ply);
 
 	if (	type != Search::nodeType::ROOT_NODE
 			&& type != Search::nodeType::HELPER_ROOT_NODE
-			&& tte->getDepth() >= (depth +1 - ONE_PLY)
+			&& tte.getDepth() >= (depth +1 - ONE_PLY)
 		    && ttValue != SCORE_NONE // Only in case of TT access race
 		    && (	PVnode ?  false
-		            : ttValue >= beta ? tte->isTypeGoodForBetaCutoff()
-		                              : tte->isTypeGoodForAlphaCutoff()))
+		            : ttValue >= beta ? tte.isTypeGoodForBetaCutoff()
+		                              : tte.isTypeGoodForAlphaCutoff()))
 	{
-		TT.refresh(*tte);
+		TT.refresh(tte);
+		TT.recordCutoff();
 
 		//save killers
 		if (ttValue >= beta
@@ -679,7 +878,7 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 						typeExact,
 						std::min(90, depth + 6 * ONE_PLY),
 						ttMove.packed,
-						pos.eval<false>());
+						evaluatePosition());
 
 				return value;
 			}
@@ -693,9 +892,9 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 
 	Score staticEval;
 	Score eval;
-	if(inCheck || tte->getType() == typeVoid)
+	if(inCheck || tte.getType() == typeVoid)
 	{
-		staticEval = pos.eval<false>();
+		staticEval = evaluatePosition();
 		eval = staticEval;
 
 #ifdef DEBUG_EVAL_SIMMETRY
@@ -710,7 +909,7 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 	}
 	else
 	{
-		staticEval = tte->getStaticValue();
+		staticEval = tte.getStaticValue();
 		assert(staticEval < SCORE_INFINITE);
 		assert(staticEval > -SCORE_INFINITE);
 
@@ -719,8 +918,8 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 		if (ttValue != SCORE_NONE)
 		{
 			if (
-					( tte->isTypeGoodForBetaCutoff() && (ttValue > eval) )
-					|| (tte->isTypeGoodForAlphaCutoff() && (ttValue < eval) )
+					( tte.isTypeGoodForBetaCutoff() && (ttValue > eval) )
+					|| (tte.isTypeGoodForAlphaCutoff() && (ttValue < eval) )
 				)
 			{
 				eval = ttValue;
@@ -851,8 +1050,8 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 			}
 			/*else
 			{
-				const ttEntry * const tteNull = TT.probe(nullKey);
-				threatMove = tteNull != nullptr ? tteNull->getPackedMove() : Movegen::NOMOVE;
+				const ttEntry tteNull = TT.probe(nullKey);
+				threatMove = tteNull.getPackedMove();
 			}*/
 
 		}
@@ -916,7 +1115,7 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 		sd[ply].skipNullMove = skipBackup;
 
 		tte = TT.probe(posKey);
-		ttMove = tte->getPackedMove();
+		ttMove = tte.getPackedMove();
 	}
 
 
@@ -938,9 +1137,8 @@ template<Search::nodeType type> Score Search::alphaBeta(unsigned int ply, int de
 		&& depth >= (PVnode ? 6 * ONE_PLY : 8 * ONE_PLY)
 		&& ttMove.packed != 0
 		&& !excludedMove.packed // Recursive singular Search is not allowed
-		&& tte != nullptr
-		&& tte->isTypeGoodForBetaCutoff()
-		&&  tte->getDepth() >= depth - 3 * ONE_PLY;
+		&& tte.isTypeGoodForBetaCutoff()
+		&&  tte.getDepth() >= depth - 3 * ONE_PLY;
 
 	while (bestScore <beta  && ( m = mg.getNextMove() ) != Movegen::NOMOVE)
 	{
@@ -1306,7 +1504,8 @@ template<Search::nodeType type> Score Search::qsearch(unsigned int ply, int dept
 	bool inCheck = pos.isInCheck();
 
 	maxPlyReached = std::max(ply, maxPlyReached);
-	visitedNodes++;
+	countNode();
+	pollNodeLimit();
 
 
 
@@ -1343,19 +1542,20 @@ template<Search::nodeType type> Score Search::qsearch(unsigned int ply, int dept
 				Search::nodeType::PV_NODE;
 
 
-	ttEntry* const tte = TT.probe(pos.getKey());
-	Move ttMove = tte->getPackedMove();
+	const ttEntry tte = TT.probe(pos.getKey());
+	Move ttMove = tte.getPackedMove();
 
 	Movegen mg(pos, *this, ply, ttMove);
 	int TTdepth = mg.setupQuiescentSearch(inCheck, depth);
-	Score ttValue = transpositionTable::scoreFromTT(tte->getValue(),ply);
-	if (tte->getDepth() >= TTdepth
+	Score ttValue = transpositionTable::scoreFromTT(tte.getValue(),ply);
+	if (tte.getDepth() >= TTdepth
 	    && ttValue != SCORE_NONE // Only in case of TT access race
 	    && (	PVnode ?  false
-	            : ttValue >= beta ? tte->isTypeGoodForBetaCutoff()
-	                              : tte->isTypeGoodForAlphaCutoff()))
+	            : ttValue >= beta ? tte.isTypeGoodForBetaCutoff()
+	                              : tte.isTypeGoodForAlphaCutoff()))
 	{
-		TT.refresh(*tte);
+		TT.refresh(tte);
+		TT.recordCutoff();
 
 		if(PVnode)
 		{
@@ -1394,7 +1594,7 @@ template<Search::nodeType type> Score Search::qsearch(unsigned int ply, int dept
 	ttType TTtype = typeScoreLowerThanAlpha;
 
 
-	Score staticEval = tte->getType()!=typeVoid ? tte->getStaticValue() : pos.eval<false>();
+	Score staticEval = tte.getType()!=typeVoid ? tte.getStaticValue() : evaluatePosition();
 #ifdef DEBUG_EVAL_SIMMETRY
 	ppp.setupFromFen(pos.getSymmetricFen());
 	Score test = ppp.eval<false>();
@@ -1424,8 +1624,8 @@ template<Search::nodeType type> Score Search::qsearch(unsigned int ply, int dept
 		if (ttValue != SCORE_NONE)
 		{
 			if (
-					( tte->isTypeGoodForBetaCutoff() && (ttValue > staticEval) )
-					|| (tte->isTypeGoodForAlphaCutoff() && (ttValue < staticEval) )
+					( tte.isTypeGoodForBetaCutoff() && (ttValue > staticEval) )
+					|| (tte.isTypeGoodForAlphaCutoff() && (ttValue < staticEval) )
 			)
 			{
 				bestScore = ttValue;
@@ -22,31 +22,82 @@
 #include <list>
 #include <cmath>
 #include <string>
+#include <algorithm>
+#include <atomic>
 #include "vajolet.h"
 #include "position.h"
 #include "move.h"
 #include "history.h"
 #include "eval.h"
 
-class PVline : public std::list<Move> 
+/*! \brief principal variation stored inline in a fixed size array, so that the search never allocates memory for it
+	every insertion is clamped to maxLength: a longer line keeps its first maxLength moves, the ones nearer to the root
+*/
+class PVline
 {
 public:
+	static const unsigned int maxLength = 128;
+	typedef Move* iterator;
+	typedef const Move* const_iterator;
+
+private:
+	unsigned int length = 0;
+	Move moves[maxLength];
+
+public:
+	PVline(){}
+	PVline(const PVline& other)
+	{
+		*this = other;
+	}
+
+	PVline& operator=(const PVline& other)
+	{
+		length = other.length;
+		std::copy(other.begin(), other.end(), moves);
+		return *this;
+	}
+
+	inline iterator begin() { return moves; }
+	inline iterator end() { return moves + length; }
+	inline const_iterator begin() const { return moves; }
+	inline const_iterator end() const { return moves + length; }
+	inline unsigned int size() const { return length; }
+	inline Move& front() { assert( length > 0 ); return moves[0]; }
+	inline const Move& front() const { assert( length > 0 ); return moves[0]; }
+
+	inline void clear()
+	{
+		length = 0;
+	}
+
 	inline void reset()
 	{
 		clear();
 	}
-	
-	inline void appendNewPvLine( Move bestMove, PVline childPV )
+
+	inline void emplace_back( const Move& move )
 	{
-		clear();
-		emplace_back( bestMove );
-		splice( end(), childPV );
+		assert( length <= maxLength );
+		if( length < maxLength )
+		{
+			moves[length++] = move;
+		}
+	}
+
+	/*! \brief bestMove followed by the line of the child node, without the child moves that don't fit*/
+	inline void appendNewPvLine( Move bestMove, const PVline& childPV )
+	{
+		assert( childPV.length <= maxLength );
+		moves[0] = bestMove;
+		length = 1 + std::min( childPV.length, maxLength - 1 );
+		std::copy(childPV.moves, childPV.moves + length - 1, moves + 1);
 	}
-	
+
 	inline void appendNewMove( Move move )
 	{
-		clear();
-		emplace_back( move );
+		moves[0] = move;
+		length = 1;
 	}
 };
 
@@ -55,14 +106,14 @@ struct startThinkResult
 	Score alpha;
 	Score beta;
 	unsigned int depth;
-	std::list<Move> PV;
+	PVline PV;
 	Score Res;
 };
 
 class searchLimits
 {
 public:
-	volatile bool ponder,infinite;
+	std::atomic<bool> ponder,infinite;
 	unsigned int wtime,btime,winc,binc,movesToGo,nodes,mate,moveTime;
 	int depth;
 	std::list<Move> searchMoves;
@@ -81,6 +132,28 @@ public:
 		moveTime = 0;
 	}
 
+	searchLimits(const searchLimits& other)
+	{
+		*this = other;
+	}
+
+	searchLimits& operator=(const searchLimits& other)
+	{
+		ponder = other.ponder.load();
+		infinite = other.infinite.load();
+		wtime = other.wtime;
+		btime = other.btime;
+		winc = other.winc;
+		binc = other.binc;
+		movesToGo = other.movesToGo;
+		depth = other.depth;
+		nodes = other.nodes;
+		mate = other.mate;
+		moveTime = other.moveTime;
+		searchMoves = other.searchMoves;
+		return *this;
+	}
+
 };
 
 class rootMove
@@ -88,7 +161,7 @@ class rootMove
 public:
 	Score score = -SCORE_INFINITE;
 	Score previousScore = -SCORE_INFINITE;
-	std::list<Move> PV;
+	PVline PV;
 	Move firstMove;
 	unsigned int maxPlyReached = 0u;
 	unsigned int depth = 0u;
@@ -114,9 +187,47 @@ public:
 	Move killers[2];
 };
 
+/*! \brief keys of the positions visited by a searcher
+	used by the smp benchmark to measure how much of the helpers work is duplicated by the main thread.
+	every visit appends the full key, so the memory grows with the node count (8 bytes per node); the keys are
+	sorted and made unique only when they are compared
+*/
+class visitedPositions
+{
+public:
+	void clear()
+	{
+		keys.clear();
+	}
+
+	inline void insert(const U64 key)
+	{
+		keys.push_back(key);
+	}
+
+	const std::vector<U64>& getKeys() const { return keys; }
+
+private:
+	std::vector<U64> keys;
+};
+
+/*! \brief lookups and hits of the eval caches*/
+struct evalCacheStats
+{
+	unsigned long long probes;
+	unsigned long long hits;
+};
+
+/*! \brief distinct positions visited by the helper threads and how many of them were visited by the main thread too*/
+struct duplicatedNodes
+{
+	unsigned long long helperPositions;
+	unsigned long long duplicated;
+};
 
 class Search
 {
+	friend class helperThreadPool;
 private:
 	bool mainSearcher;
 	bool followPV;
@@ -162,6 +273,10 @@ private:
 		tempKillers[0] = 0;
 	}
 
+	/*! \brief stop the search when the node limit is reached, checked by the main searcher every nodeLimitPollInterval nodes*/
+	static const unsigned long long nodeLimitPollInterval = 1024;
+	void pollNodeLimit();
+
 	signed int razorMargin(unsigned int depth,bool cut) const { return 20000+depth*78+cut*20000; }
 
 	enum nodeType
@@ -179,6 +294,33 @@ private:
 
 	unsigned long long visitedNodes;
 	unsigned long long tbHits;
+	visitedPositions visited;
+	evalTable evalCache;
+	pawnTable pawnHash;
+	materialTable materialHash;
+
+	/*! \brief static evaluation of the position, looked up in the eval cache before calling eval*/
+	inline Score evaluatePosition()
+	{
+		Score s;
+		if( !evalCache.probe(pos.getKey(), s) )
+		{
+			s = pos.eval<false>();
+			evalCache.store(pos.getKey(), s);
+		}
+		return s;
+	}
+
+	inline void countNode()
+	{
+		visitedNodes++;
+#ifdef ENABLE_VISITED_POSITIONS
+		if( recordVisitedPositions )
+		{
+			visited.insert( pos.getKey() );
+		}
+#endif
+	}
 
 	unsigned int maxPlyReached;
 
@@ -188,10 +330,16 @@ private:
 public:
 
 	static std::vector<rootMove> rootMoves;
-	std::list<Move> PV;
+	PVline PV;
 	searchLimits limits;
 	Position pos;
 
+	Search()
+	{
+		pos.setPawnTable(&pawnHash);
+		pos.setMaterialTable(&materialHash);
+	}
+
 	const History& getHistory()const {return history;}
 	const CounterMove& getCounterMove()const {return  counterMoves;}
 
@@ -205,7 +353,12 @@ public:
 	static std::string SyzygyPath;
 	static unsigned int SyzygyProbeDepth;
 	static bool Syzygy50MoveRule;
-	volatile bool showLine = false;
+	static unsigned int evalCacheSize;	/*!< MB of eval cache of every thread*/
+	static unsigned int pawnHashSize;	/*!< MB of pawn hash table of every thread*/
+	/*! \brief record the visited positions of every searcher, see getDuplicatedNodes. needs a build with ENABLE_VISITED_POSITIONS*/
+	static bool recordVisitedPositions;
+	static bool silentOutput;	/*!< don't print the info lines of the search, set by the benchmarks*/
+	std::atomic<bool> showLine{false};
 
 	static void initLMRreduction(void)
 	{
@@ -220,7 +373,7 @@ public:
 	};
 
 	void stopPonder(){ limits.ponder = false;}
-	volatile bool stop = false;
+	std::atomic<bool> stop{false};
 
 
 	const Move&  getKillers(unsigned int ply,unsigned int n) const { return sd[ply].killers[n]; }
@@ -229,6 +382,8 @@ public:
 	startThinkResult startThinking(int depth = 1, Score alpha = -SCORE_INFINITE, Score beta = SCORE_INFINITE);
 	unsigned long long getVisitedNodes() const;
 	unsigned long long getTbHits() const;
+	duplicatedNodes getDuplicatedNodes() const;
+	evalCacheStats getEvalCacheStats() const;
 
 private:
 	// gestione timer
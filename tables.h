@@ -20,7 +20,12 @@
 #define TABLES_H_
 
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
 
 class pawnEntry
 {
@@ -34,12 +39,41 @@ public:
 	Score res[2];
 };
 
+/*! \brief pawn structure hash table, owned by a search thread and used by the Position it searches
+	the entries are allocated once, aligned to the cache line, and selected by the lower bits of the pawn key
+*/
 class pawnTable
 {
-static const int size = 8192;
+	static const size_t cacheLineSize = 64;
 public:
+	/*! \brief allocate mbSize MB (a power of two number of entries, at least one) and clear the table
+		nothing is done if the number of entries doesn't change
+	*/
+	void setSize(unsigned int mbSize)
+	{
+		size_t entries = 1;
+		while( entries * 2 * sizeof(pawnEntry) <= ( (size_t)mbSize << 20 ) )
+		{
+			entries *= 2;
+		}
+		if( entries == size )
+		{
+			return;
+		}
+		storage.reset( new char[ entries * sizeof(pawnEntry) + cacheLineSize - 1 ] );
+		table = reinterpret_cast<pawnEntry*>( ( reinterpret_cast<uintptr_t>( storage.get() ) + cacheLineSize - 1 ) & ~(uintptr_t)( cacheLineSize - 1 ) );
+		for( size_t i = 0; i < entries; ++i )
+		{
+			new (&table[i]) pawnEntry();
+		}
+		size = entries;
+		mask = entries - 1;
+	}
+
+	unsigned long int getSize() const { return size; }
+
 	void insert(U64 key,simdScore res,bitMap weak, bitMap passed,bitMap whiteAttack, bitMap blackAttack, bitMap weakSquareWhite,bitMap weakSquareBlack, bitMap whiteHoles, bitMap blackHoles){
-		pawnEntry& x=pawnTable[((unsigned int)key) %size];
+		pawnEntry& x = table[ key & mask ];
 
 		x.key=key;
 		x.res[0]=res[0];
@@ -56,12 +90,136 @@ public:
 		x.holes[1]=blackHoles;
 	}
 
-	pawnEntry& probe(U64 key)
+	/*! \brief return the entry of the key, nullptr if the table has not been allocated*/
+	pawnEntry* probe(U64 key)
 	{
-		return pawnTable[((unsigned int)key) %size];
+		return size ? &table[ key & mask ] : nullptr;
 	}
 private:
-	std::array<pawnEntry,size> pawnTable;
+	std::unique_ptr<char[]> storage;
+	pawnEntry* table = nullptr;
+	size_t size = 0;
+	U64 mask = 0;
+};
+
+class Position;
+
+/*! \brief specialized evaluation of a material signature, see Position::initMaterialKeys*/
+struct materialStruct
+{
+	typedef enum
+	{
+		exact,
+		multiplicativeFunction,
+		exactFunction,
+		saturationH,
+		saturationL,
+	} tType ;
+	tType type;
+	bool (Position::*pointer)(Score &);
+	Score val;
+
+};
+
+/*! \brief everything the evaluation needs that depends only on the material signature*/
+struct materialEntry
+{
+	U64 key;
+	const materialStruct* endgame;	/*!< nullptr when there is no specialized evaluation*/
+	simdScore imbalance;	/*!< material imbalance terms not depending on the position of the pieces*/
+	unsigned int gamePhase;	/*!< see Position::getGamePhase*/
+	bool kingVsPieces;	/*!< one side has only the king, the other one has some pieces*/
+};
+
+/*! \brief material hash table, owned by a search thread like the pawn table
+	the entries are filled by Position::getMaterialEntry the first time a material signature is evaluated
+*/
+class materialTable
+{
+public:
+	static const size_t size = 8192;
+
+	materialTable(): table( new materialEntry[size]() ){}
+
+	materialEntry& probe(U64 key)
+	{
+		return table[ key % size ];
+	}
+private:
+	std::unique_ptr<materialEntry[]> table;
+};
+
+/*! \brief direct mapped cache of the static evaluations, 8 bytes per entry
+	the entry keeps the upper 32 bits of the key and the score, the lower bits of the key select the entry
+*/
+class evalTable
+{
+	struct evalEntry
+	{
+		uint32_t key;
+		int32_t score;
+	};
+public:
+	/*! \brief allocate mbSize MB (a power of two number of entries) and clear the table, 0 disables it*/
+	void setSize(unsigned int mbSize)
+	{
+		size_t entries = 0;
+		if( mbSize )
+		{
+			entries = 1;
+			while( entries * 2 * sizeof(evalEntry) <= ( (size_t)mbSize << 20 ) )
+			{
+				entries *= 2;
+			}
+		}
+		if( entries != table.size() )
+		{
+			std::vector<evalEntry>(entries).swap(table);
+			mask = entries ? entries - 1 : 0;
+		}
+		clear();
+	}
+
+	void clear()
+	{
+		std::fill( table.begin(), table.end(), evalEntry{0, 0} );
+		probes = 0;
+		hits = 0;
+	}
+
+	inline bool probe(const U64 key, Score& score)
+	{
+		if( table.empty() )
+		{
+			return false;
+		}
+		++probes;
+		const evalEntry& e = table[ key & mask ];
+		if( e.key == (uint32_t)( key >> 32 ) )
+		{
+			++hits;
+			score = e.score;
+			return true;
+		}
+		return false;
+	}
+
+	inline void store(const U64 key, const Score score)
+	{
+		if( !table.empty() )
+		{
+			table[ key & mask ] = evalEntry{ (uint32_t)( key >> 32 ), score };
+		}
+	}
+
+	unsigned long long getProbes() const { return probes; }
+	unsigned long long getHits() const { return hits; }
+
+private:
+	std::vector<evalEntry> table;
+	U64 mask = 0;
+	unsigned long long probes = 0;
+	unsigned long long hits = 0;
 };
 
 #endif /* TABLES_H_ */
@@ -0,0 +1,337 @@
+#include "benchmark/benchmark.h"
+
+#include <random>
+#include <string>
+#include <vector>
+#include "./../../io.h"
+#include "./../../bitops.h"
+#include "./../../data.h"
+#include "./../../hashKeys.h"
+#include "./../../position.h"
+#include "./../../movegen.h"
+#include "./../../search.h"
+#include "./../../transposition.h"
+#include "./../../tables.h"
+
+/* micro benchmarks of the engine hot paths over a fixed corpus of positions.
+   every benchmark reports items per second (moves, positions, probes...), run with --benchmark_repetitions=n to get mean and deviation */
+
+static const std::vector<std::string> corpus = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+	"4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+	"rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+	"r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+	"r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+	"2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+	"3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+	"4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22"
+};
+
+/* positions with the side to move in check */
+static const std::vector<std::string> evasionCorpus = {
+	"rnbqkbnr/ppp2ppp/8/1B1pp3/4P3/8/PPPP1PPP/RNBQK1NR b KQkq - 1 3",
+	"4k3/8/8/8/8/8/4r3/R3K3 w Q - 0 1",
+	"r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/5N2/PPPP1KPP/RNBQ3R w kq - 0 5",
+	"rnbqkbnr/pppp1ppp/5N2/4p3/8/8/PPPPPPPP/R1BQKBNR b KQkq - 0 1"
+};
+
+static std::vector<Position> setupCorpus(const std::vector<std::string>& fens)
+{
+	std::vector<Position> positions(fens.size());
+	for( unsigned int i = 0; i < fens.size(); i++ )
+	{
+		positions[i].setupFromFen(fens[i]);
+	}
+	return positions;
+}
+
+static std::vector<Move> getLegalMoves(const Position& pos)
+{
+	Movegen mg(pos);
+	const unsigned int n = mg.getNumberOfLegalMoves();
+	std::vector<Move> moves;
+	for( unsigned int i = 0; i < n; i++ )
+	{
+		moves.push_back( mg.getMoveFromMoveList(i) );
+	}
+	return moves;
+}
+
+//---------------------------------------------
+//	make / unmake
+//---------------------------------------------
+static void BM_doUndoMove(benchmark::State& state)
+{
+	std::vector<Position> positions = setupCorpus(corpus);
+	std::vector<std::vector<Move>> moves;
+	for( auto& pos: positions )
+	{
+		moves.push_back( getLegalMoves(pos) );
+	}
+
+	unsigned long long count = 0;
+	for( auto _ : state )
+	{
+		for( unsigned int i = 0; i < positions.size(); i++ )
+		{
+			for( auto& m: moves[i] )
+			{
+				positions[i].doMove(m);
+				positions[i].undoMove();
+			}
+			count += moves[i].size();
+		}
+	}
+	state.SetItemsProcessed(count);
+}
+BENCHMARK(BM_doUndoMove);
+
+//---------------------------------------------
+//	evaluation
+//---------------------------------------------
+static void BM_eval(benchmark::State& state)
+{
+	std::vector<Position> positions = setupCorpus(corpus);
+	// the pawn and material tables of a searcher, without them every evaluation recalculates the pawn structure
+	pawnTable pawnHash;
+	materialTable materialHash;
+	pawnHash.setSize(Search::pawnHashSize);
+	for( auto& pos: positions )
+	{
+		pos.setPawnTable(&pawnHash);
+		pos.setMaterialTable(&materialHash);
+	}
+
+	for( auto _ : state )
+	{
+		for( auto& pos: positions )
+		{
+			benchmark::DoNotOptimize( pos.eval<false>() );
+		}
+	}
+	state.SetItemsProcessed( state.iterations() * positions.size() );
+}
+BENCHMARK(BM_eval);
+
+//---------------------------------------------
+//	static exchange evaluation
+//---------------------------------------------
+static void BM_see(benchmark::State& state)
+{
+	std::vector<Position> positions = setupCorpus(corpus);
+	std::vector<std::vector<Move>> captures(positions.size());
+	for( unsigned int i = 0; i < positions.size(); i++ )
+	{
+		for( auto& m: getLegalMoves(positions[i]) )
+		{
+			if( positions[i].isCaptureMove(m) )
+			{
+				captures[i].push_back(m);
+			}
+		}
+	}
+
+	unsigned long long count = 0;
+	for( auto _ : state )
+	{
+		for( unsigned int i = 0; i < positions.size(); i++ )
+		{
+			for( auto& m: captures[i] )
+			{
+				benchmark::DoNotOptimize( positions[i].see(m) );
+			}
+			count += captures[i].size();
+		}
+	}
+	state.SetItemsProcessed(count);
+}
+BENCHMARK(BM_see);
+
+//---------------------------------------------
+//	move generation
+//---------------------------------------------
+enum movegenStage
+{
+	legalMoves,			// getNumberOfLegalMoves, generation without staging and scoring
+	mainSearch,			// staged generator of the main search: captures, killers, counters, quiet and bad captures
+	qsearchCaptures,	// quiescence search captures
+	qsearchChecks,		// first ply of the quiescence search: captures and quiet checks
+	evasions			// positions in check
+};
+
+template<movegenStage stage>
+static void BM_movegen(benchmark::State& state)
+{
+	std::vector<Position> positions = setupCorpus( stage == evasions ? evasionCorpus : corpus );
+
+	unsigned long long count = 0;
+	for( auto _ : state )
+	{
+		for( auto& pos: positions )
+		{
+			Movegen mg(pos, defaultSearch, 0, Movegen::NOMOVE);
+			if( stage == legalMoves )
+			{
+				count += mg.getNumberOfLegalMoves();
+				continue;
+			}
+			if( stage == qsearchCaptures )
+			{
+				mg.setupQuiescentSearch(false, -2 * ONE_PLY);
+			}
+			else if( stage == qsearchChecks )
+			{
+				mg.setupQuiescentSearch(false, 0);
+			}
+			while( mg.getNextMove().packed )
+			{
+				++count;
+			}
+		}
+	}
+	state.SetItemsProcessed(count);
+}
+BENCHMARK_TEMPLATE(BM_movegen, legalMoves);
+BENCHMARK_TEMPLATE(BM_movegen, mainSearch);
+BENCHMARK_TEMPLATE(BM_movegen, qsearchCaptures);
+BENCHMARK_TEMPLATE(BM_movegen, qsearchChecks);
+BENCHMARK_TEMPLATE(BM_movegen, evasions);
+
+//---------------------------------------------
+//	transposition table, the argument is the table size in MB
+//---------------------------------------------
+static std::vector<U64> getRandomKeys(unsigned int n)
+{
+	std::vector<U64> keys(n);
+	std::mt19937_64 rng(1);
+	for( auto& k: keys )
+	{
+		k = rng();
+	}
+	return keys;
+}
+
+static void BM_ttStore(benchmark::State& state)
+{
+	transpositionTable tt;
+	tt.setSize( state.range(0) );
+	const std::vector<U64> keys = getRandomKeys(1 << 20);
+
+	unsigned int i = 0;
+	for( auto _ : state )
+	{
+		tt.store(keys[ i & ( keys.size() - 1 ) ], (Score)i, typeExact, 10, (unsigned short)i, 0);
+		++i;
+	}
+	state.SetItemsProcessed( state.iterations() );
+}
+BENCHMARK(BM_ttStore)->Arg(1)->Arg(64);
+
+static void BM_ttProbe(benchmark::State& state)
+{
+	transpositionTable tt;
+	tt.setSize( state.range(0) );
+	const std::vector<U64> keys = getRandomKeys(1 << 20);
+	for( unsigned int i = 0; i < keys.size(); i++ )
+	{
+		tt.store(keys[i], (Score)i, typeExact, 10, (unsigned short)i, 0);
+	}
+
+	unsigned int i = 0;
+	for( auto _ : state )
+	{
+		benchmark::DoNotOptimize( tt.probe( keys[ i & ( keys.size() - 1 ) ] ) );
+		++i;
+	}
+	state.SetItemsProcessed( state.iterations() );
+}
+BENCHMARK(BM_ttProbe)->Arg(1)->Arg(64);
+
+//---------------------------------------------
+//	draw detection, after some reversible moves so that the repetition loop has states to check
+//---------------------------------------------
+static void BM_isDraw(benchmark::State& state)
+{
+	std::vector<Position> positions = setupCorpus(corpus);
+	for( auto& pos: positions )
+	{
+		for( unsigned int ply = 0; ply < 12; ply++ )
+		{
+			bool moved = false;
+			for( auto& m: getLegalMoves(pos) )
+			{
+				if( !pos.isCaptureMove(m) && !Position::isPawn( pos.getPieceAt( (tSquare)m.bit.from ) ) )
+				{
+					pos.doMove(m);
+					moved = true;
+					break;
+				}
+			}
+			if( !moved )
+			{
+				break;
+			}
+		}
+	}
+
+	for( auto _ : state )
+	{
+		for( auto& pos: positions )
+		{
+			benchmark::DoNotOptimize( pos.isDraw( state.range(0) ) );
+		}
+	}
+	state.SetItemsProcessed( state.iterations() * positions.size() );
+}
+BENCHMARK(BM_isDraw)->Arg(0)->Arg(1);
+
+//---------------------------------------------
+//	magic attack lookups
+//---------------------------------------------
+template<Position::bitboardIndex piece>
+static void BM_attackFrom(benchmark::State& state)
+{
+	std::vector<bitMap> occupancies;
+	for( auto& pos: setupCorpus(corpus) )
+	{
+		occupancies.push_back( pos.getOccupationBitmap() );
+	}
+
+	for( auto _ : state )
+	{
+		for( auto occ: occupancies )
+		{
+			for( tSquare sq = A1; sq < squareNumber; sq++ )
+			{
+				benchmark::DoNotOptimize( Movegen::attackFrom<piece>(sq, occ) );
+			}
+		}
+	}
+	state.SetItemsProcessed( state.iterations() * occupancies.size() * (unsigned int)squareNumber );
+}
+BENCHMARK_TEMPLATE(BM_attackFrom, Position::whiteRooks);
+BENCHMARK_TEMPLATE(BM_attackFrom, Position::whiteBishops);
+BENCHMARK_TEMPLATE(BM_attackFrom, Position::whiteQueens);
+
+
+int main(int argc, char **argv)
+{
+	initData();
+	HashKeys::init();
+	Position::initScoreValues();
+	Position::initCastleRightsMask();
+	Movegen::initMovegenConstant();
+	Search::initLMRreduction();
+	Position::initMaterialKeys();
+
+	benchmark::Initialize(&argc, argv);
+	if( benchmark::ReportUnrecognizedArguments(argc, argv) )
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+#include "./../position.h"
+#include "./../movegen.h"
+#include "./../nnue.h"
+
+static const std::string testNetwork = "nnue-test.nnue";
+
+template<typename T>
+static void writeRandom(std::ofstream& ofs, std::mt19937& rng, const size_t n, const int range)
+{
+	std::uniform_int_distribution<int> dist(-range, range);
+	for( size_t i = 0; i < n; ++i )
+	{
+		const T v = (T)dist(rng);
+		ofs.write( reinterpret_cast<const char*>(&v), sizeof(v) );
+	}
+}
+
+/* network file with random weights, in the format documented in nnue.h. truncate removes the last bytes */
+static void writeTestNetwork(const std::string& fileName, const unsigned int truncate = 0)
+{
+	std::mt19937 rng(42);
+	{
+		std::ofstream ofs(fileName, std::ios::binary);
+		ofs.write("VNUE", 4);
+		const uint32_t header[5] = { 1, nnueNetwork::inputs, nnueAccumulator::size, nnueNetwork::hidden1, nnueNetwork::hidden2 };
+		ofs.write( reinterpret_cast<const char*>(header), 5 * sizeof(uint32_t) );
+		const int32_t scale = 2048;
+		ofs.write( reinterpret_cast<const char*>(&scale), sizeof(scale) );
+		writeRandom<int16_t>(ofs, rng, nnueAccumulator::size, 64);
+		writeRandom<int16_t>(ofs, rng, nnueNetwork::inputs * nnueAccumulator::size, 64);
+		writeRandom<int32_t>(ofs, rng, nnueNetwork::hidden1, 1000);
+		writeRandom<int16_t>(ofs, rng, nnueNetwork::hidden1 * 2 * nnueAccumulator::size, 64);
+		writeRandom<int32_t>(ofs, rng, nnueNetwork::hidden2, 1000);
+		writeRandom<int16_t>(ofs, rng, nnueNetwork::hidden2 * nnueNetwork::hidden1, 64);
+		writeRandom<int32_t>(ofs, rng, 1, 1000);
+		writeRandom<int16_t>(ofs, rng, nnueNetwork::hidden2, 64);
+	}
+	if( truncate )
+	{
+		std::ifstream ifs(fileName, std::ios::binary);
+		std::string data( (std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>() );
+		ifs.close();
+		std::ofstream ofs(fileName, std::ios::binary);
+		ofs.write( data.data(), data.size() - truncate );
+	}
+}
+
+/* evaluation of the same position calculated from scratch */
+static Score refreshedEval(const Position& pos)
+{
+	Position p;
+	p.setupFromFen( pos.getFen() );
+	return p.evalNnue();
+}
+
+/* the positions evaluate with the global network: the tests load their network in it and the guard
+   puts back the previous one and the UseNNUE flag, also when a test fails */
+class globalNetworkGuard
+{
+public:
+	globalNetworkGuard(): enabled(nnueNetwork::enabled)
+	{
+		std::swap( saved, NNUE );
+	}
+	~globalNetworkGuard()
+	{
+		std::swap( saved, NNUE );
+		nnueNetwork::enabled = enabled;
+	}
+private:
+	nnueNetwork saved;
+	const bool enabled;
+};
+
+TEST(Nnue, loadErrors)
+{
+	nnueNetwork net;
+	std::string error;
+	EXPECT_FALSE( net.load("missing-network.nnue", error) );
+	EXPECT_FALSE( error.empty() );
+
+	writeTestNetwork(testNetwork, 10);
+	EXPECT_FALSE( net.load(testNetwork, error) );
+	EXPECT_FALSE( net.isLoaded() );
+
+	writeTestNetwork(testNetwork);
+	EXPECT_TRUE( net.load(testNetwork, error) );
+	EXPECT_TRUE( net.isLoaded() );
+	std::remove( testNetwork.c_str() );
+}
+
+/* random games with captures, castling, en passant and promotions: the incrementally updated accumulators
+   shall give the same evaluation as a refresh, going forward and after undoing the moves */
+TEST(Nnue, incrementalUpdate)
+{
+	globalNetworkGuard guard;
+	writeTestNetwork(testNetwork);
+	std::string error;
+	ASSERT_TRUE( NNUE.load(testNetwork, error) );
+	std::remove( testNetwork.c_str() );
+
+	const std::vector<std::string> fens = {
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+		"n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"
+	};
+
+	std::mt19937 rng(7);
+	std::set<Score> distinctScores;
+	for( const auto& fen: fens )
+	{
+		for( unsigned int game = 0; game < 10; ++game )
+		{
+			Position pos;
+			pos.setupFromFen(fen);
+			std::vector<Score> scores;
+			scores.push_back( pos.evalNnue() );
+			unsigned int plies = 0;
+			for( ; plies < 40; ++plies )
+			{
+				Movegen mg(pos);
+				const unsigned int n = mg.getNumberOfLegalMoves();
+				if( n == 0 )
+				{
+					break;
+				}
+				pos.doMove( mg.getMoveFromMoveList( rng() % n ) );
+				// skip some evaluations, so that several moves are applied at once
+				if( rng() % 3 )
+				{
+					scores.push_back( pos.evalNnue() );
+					distinctScores.insert( scores.back() );
+					ASSERT_EQ( scores.back(), refreshedEval(pos) ) << pos.getFen();
+				}
+				else
+				{
+					scores.push_back( refreshedEval(pos) );
+				}
+
+				// the copy of a position doesn't copy the accumulators
+				if( plies == 20 )
+				{
+					Position copy(pos);
+					EXPECT_EQ( copy.evalNnue(), scores.back() );
+				}
+			}
+			while( plies-- )
+			{
+				pos.undoMove();
+				scores.pop_back();
+				ASSERT_EQ( pos.evalNnue(), scores.back() ) << pos.getFen();
+			}
+		}
+	}
+	// the random network is not saturated
+	EXPECT_GT( distinctScores.size(), 100u );
+}
+
+TEST(Nnue, evalSwitch)
+{
+	globalNetworkGuard guard;
+	writeTestNetwork(testNetwork);
+	std::string error;
+	ASSERT_TRUE( NNUE.load(testNetwork, error) );
+	std::remove( testNetwork.c_str() );
+
+	Position pos;
+	pos.setupFromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10");
+	Position::initMaterialKeys();
+	const Score classical = pos.eval<false>();
+
+	nnueNetwork::enabled = true;
+	EXPECT_EQ( pos.eval<false>(), pos.evalNnue() );
+	nnueNetwork::enabled = false;
+	EXPECT_EQ( pos.eval<false>(), classical );
+}
+
+TEST(Nnue, globalNetworkRestored)
+{
+	const bool loaded = NNUE.isLoaded();
+	const std::string fileName = NNUE.getFileName();
+	{
+		globalNetworkGuard guard;
+		writeTestNetwork(testNetwork);
+		std::string error;
+		ASSERT_TRUE( NNUE.load(testNetwork, error) );
+		std::remove( testNetwork.c_str() );
+		nnueNetwork::enabled = !nnueNetwork::enabled;
+	}
+	EXPECT_EQ( NNUE.isLoaded(), loaded );
+	EXPECT_EQ( NNUE.getFileName(), fileName );
+	EXPECT_FALSE( nnueNetwork::enabled );
+}
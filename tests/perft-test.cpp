@@ -1,6 +1,7 @@
 #include <vector>
 #include "gtest/gtest.h"
 #include "./../position.h"
+#include "./../perft.h"
 
 typedef struct _positions
 {
@@ -54,3 +55,16 @@ TEST(LongPerftTest, perft) {
 		}
 	}
 }
+
+TEST(ParallelHashPerftTest, perft) {
+	Position pos;
+	for (auto & p : perftPos)
+	{
+		pos.setupFromFen(p.Fen);
+		Perft pft(pos, 4, 8);
+		for( unsigned int i = 0; i < 5 && i < p.PerftValue.size(); i++)
+		{
+			EXPECT_EQ(pft.perft(i+1), p.PerftValue[i]);
+		}
+	}
+}
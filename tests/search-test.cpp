@@ -0,0 +1,31 @@
+#include "gtest/gtest.h"
+#include "./../search.h"
+
+/* lines longer than PVline::maxLength keep the moves nearer to the root */
+TEST(PVline, clampedInsertion)
+{
+	const unsigned int maxLength = PVline::maxLength;
+	PVline child;
+	for( unsigned int i = 0; i < maxLength + 10; ++i )
+	{
+		child.emplace_back( Move( (unsigned short)( i + 1 ) ) );
+	}
+	ASSERT_EQ( child.size(), maxLength );
+	EXPECT_EQ( child.front().packed, 1 );
+	EXPECT_EQ( ( child.end() - 1 )->packed, maxLength );
+
+	PVline pv;
+	pv.appendNewPvLine( Move( (unsigned short)1000 ), child );
+	ASSERT_EQ( pv.size(), maxLength );
+	EXPECT_EQ( pv.front().packed, 1000 );
+	EXPECT_EQ( pv.begin()[1].packed, 1 );
+	EXPECT_EQ( ( pv.end() - 1 )->packed, maxLength - 1 );
+
+	PVline copy(pv);
+	EXPECT_TRUE( std::equal( pv.begin(), pv.end(), copy.begin(), [](const Move& a, const Move& b){ return a.packed == b.packed; } ) );
+
+	pv.appendNewMove( Move( (unsigned short)7 ) );
+	EXPECT_EQ( pv.size(), 1u );
+	pv.clear();
+	EXPECT_EQ( pv.size(), 0u );
+}
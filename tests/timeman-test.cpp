@@ -0,0 +1,159 @@
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "./../position.h"
+#include "./../search.h"
+#include "./../thread.h"
+#include "./../transposition.h"
+
+/* walk the deadlines the timer thread sleeps until, starting from the beginning of the search */
+static std::vector<long long int> deadlines(const searchLimits& lim, const timeManagementStruct& timeMan, long long int lastHasfullMessage)
+{
+	std::vector<long long int> res;
+	long long int t = 0;
+	while( ( t = getNextCheckTime( t, lim, timeMan, lastHasfullMessage ) ) != LLONG_MAX )
+	{
+		res.push_back(t);
+	}
+	return res;
+}
+
+TEST(TimeManagement, moveTimeDeadlines)
+{
+	Position::initMaterialKeys();
+	Position pos;
+	pos.setupFromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10");
+
+	searchLimits lim;
+	lim.moveTime = 50;
+	timeManagementStruct timeMan;
+	timeManagerInit(pos, lim, timeMan);
+
+	EXPECT_EQ( timeMan.allocatedTime, 50 );
+	EXPECT_EQ( timeMan.maxAllocatedTime, 51 );
+	EXPECT_EQ( timeMan.minSearchTime, 50 );
+	EXPECT_FALSE( lim.infinite );
+
+	// 70% of the allocated time, movetime, max allocated time and then only the hashfull output
+	std::vector<long long int> expected = { 35, 50, 51 };
+#ifndef DISABLE_TIME_DIPENDENT_OUTPUT
+	expected.push_back( 1001 );
+#endif
+	EXPECT_EQ( deadlines(lim, timeMan, 0), expected );
+
+	// the timer wakes up exactly at movetime even if it has been woken up by an event just before
+	EXPECT_EQ( getNextCheckTime( 49, lim, timeMan, 0 ), 50 );
+	EXPECT_EQ( getNextCheckTime( 50, lim, timeMan, 0 ), 51 );
+}
+
+TEST(TimeManagement, clockDeadlines)
+{
+	Position::initMaterialKeys();
+	Position pos;
+	pos.setupFromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+	searchLimits lim;
+	lim.wtime = 60000;
+	lim.btime = 1000;
+	timeManagementStruct timeMan;
+	timeManagerInit(pos, lim, timeMan);
+
+	// the white clock is used: 1/35 of the time, 10 times that as maximum
+	EXPECT_EQ( timeMan.allocatedTime, 1714 );
+	EXPECT_EQ( timeMan.maxAllocatedTime, 17140 );
+	EXPECT_EQ( timeMan.minSearchTime, 514 );
+
+	std::vector<long long int> expected = { 514, 1200, 1714, 17140 };
+#ifndef DISABLE_TIME_DIPENDENT_OUTPUT
+	// the hashfull output is 1001ms after the last one
+	EXPECT_EQ( getNextCheckTime( 600, lim, timeMan, 0 ), 1001 );
+	EXPECT_EQ( getNextCheckTime( 1200, lim, timeMan, 1100 ), 1714 );
+	expected = { 514, 1200, 1714, 17140, 20001 };
+	EXPECT_EQ( deadlines(lim, timeMan, 19000), expected );
+#else
+	EXPECT_EQ( deadlines(lim, timeMan, 0), expected );
+#endif
+}
+
+TEST(TimeManagement, infiniteHasNoDeadline)
+{
+	Position::initMaterialKeys();
+	Position pos;
+	pos.setupFromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+	// go without limits becomes infinite: only an event or the hashfull output wake the timer up
+	searchLimits lim;
+	timeManagementStruct timeMan;
+	timeManagerInit(pos, lim, timeMan);
+	EXPECT_TRUE( lim.infinite );
+#ifndef DISABLE_TIME_DIPENDENT_OUTPUT
+	EXPECT_EQ( getNextCheckTime( 0, lim, timeMan, 3000 ), 4001 );
+	EXPECT_EQ( getNextCheckTime( 4001, lim, timeMan, 3000 ), LLONG_MAX );
+#else
+	EXPECT_EQ( getNextCheckTime( 0, lim, timeMan, 0 ), LLONG_MAX );
+#endif
+
+	// pondering ignores the clock
+	searchLimits ponder;
+	ponder.wtime = 60000;
+	ponder.btime = 60000;
+	ponder.ponder = true;
+	timeManagerInit(pos, ponder, timeMan);
+#ifndef DISABLE_TIME_DIPENDENT_OUTPUT
+	EXPECT_EQ( getNextCheckTime( 0, ponder, timeMan, 0 ), 1001 );
+	EXPECT_EQ( getNextCheckTime( 1001, ponder, timeMan, 1000 ), 2001 );
+#else
+	EXPECT_EQ( getNextCheckTime( 0, ponder, timeMan, 0 ), LLONG_MAX );
+#endif
+}
+
+/* after a ponderhit the timer computes its deadlines again: the search stops at the allocated time of the clock.
+   the output of the engine is captured */
+TEST(TimeManagement, ponderHitStopsInTime)
+{
+	Search::initLMRreduction();
+	Position::initMaterialKeys();
+	TT.setSize(16);
+	const bool useOwnBook = Search::useOwnBook;
+	Search::useOwnBook = false;
+
+	Position pos;
+	pos.setupFromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10");
+	searchLimits limits;
+	limits.wtime = 7000;
+	limits.btime = 7000;
+	limits.ponder = true;
+
+	// 7000 / 35 ms
+	{
+		timeManagementStruct timeMan;
+		searchLimits lim(limits);
+		timeManagerInit(pos, lim, timeMan);
+		ASSERT_EQ( timeMan.allocatedTime, 200 );
+	}
+
+	std::ostringstream output;
+	std::streambuf* coutBuffer = std::cout.rdbuf( output.rdbuf() );
+
+	my_thread* thr = my_thread::getInstance();
+	thr->startThinking(&pos, limits);
+	std::this_thread::sleep_for( std::chrono::milliseconds( 300 ) );
+	EXPECT_TRUE( thr->isSearching() );
+
+	const auto start = std::chrono::steady_clock::now();
+	thr->ponderHit();
+	thr->waitSearchEnd();
+	const long long int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start ).count();
+
+	std::cout.rdbuf( coutBuffer );
+	Search::useOwnBook = useOwnBook;
+
+	EXPECT_NE( output.str().find("bestmove"), std::string::npos );
+	// an aspiration window failing at the deadline extends the allocated time up to maxAllocatedTime.
+	// some slack for a loaded machine, the timer used to sleep until the next hashfull output or the end of the iteration
+	EXPECT_LT( elapsed, my_thread::timeMan.allocatedTime + 100 );
+}
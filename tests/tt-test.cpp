@@ -0,0 +1,298 @@
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+#include "gtest/gtest.h"
+#include "./../transposition.h"
+#include "./../position.h"
+#include "./../search.h"
+
+static const unsigned int keyNumber = 8;
+static const unsigned int variantNumber = 60000;
+
+/* all the keys share the lower 32 bits, so they are stored in the same cluster. the upper 16 bits differ too, for the compact layout */
+static U64 getTestKey(unsigned int i)
+{
+	return ( (U64)( i + 1 ) << 48 ) | ( (U64)( i + 1 ) << 32 ) | 0x12345ull;
+}
+
+/* every field of a stored entry is derived from (key, variant), the variant is recoverable from the move */
+static Score getTestValue(unsigned int i, unsigned int v){ return (Score)( i * 100000 + v ); }
+static Score getTestStaticValue(unsigned int i, unsigned int v){ return -(Score)( v * 7 + i ); }
+static signed short int getTestDepth(unsigned int v){ return (signed short int)( v % 200 ) - 20; }
+static unsigned char getTestType(unsigned int v){ return (unsigned char)( v % 3 ); }
+static unsigned short getTestMove(unsigned int v){ return (unsigned short)( v + 1 ); }
+
+
+TEST(TranspositionTable, storeAndProbe)
+{
+	transpositionTable tt;
+	tt.setSize(1);
+
+	U64 key = getTestKey(3);
+	EXPECT_EQ( tt.probe(key).getType(), typeVoid );
+
+	tt.store(key, -12345, typeScoreLowerThanAlpha, -32, 0x1234, 2500000);
+	ttEntry e = tt.probe(key);
+	EXPECT_EQ( e.getKey(), ttSlot::getKeyCheck(key) );
+	EXPECT_EQ( e.getValue(), -12345 );
+	EXPECT_EQ( e.getStaticValue(), 2500000 );
+	EXPECT_EQ( e.getType(), typeScoreLowerThanAlpha );
+	EXPECT_EQ( e.getDepth(), -32 );
+	EXPECT_EQ( e.getPackedMove(), 0x1234 );
+
+	// a store without move keeps the old one
+	tt.store(key, SCORE_NONE, typeExact, 100, 0, -SCORE_INFINITE + 1);
+	e = tt.probe(key);
+	EXPECT_EQ( e.getValue(), SCORE_NONE );
+	EXPECT_EQ( e.getStaticValue(), -SCORE_INFINITE + 1 );
+	EXPECT_EQ( e.getPackedMove(), 0x1234 );
+}
+
+/* a key whose stored bits are all zero shall not match a cleared slot, but it can still be stored */
+TEST(TranspositionTable, emptySlotIsNotAHit)
+{
+	transpositionTable tt;
+	tt.setSize(1);
+	tt.clear();
+
+	const U64 key = 0x12345ull;
+	ASSERT_EQ( ttSlot::getKeyCheck(key), 0u );
+	EXPECT_EQ( tt.probe(key).getType(), typeVoid );
+	EXPECT_EQ( tt.probe(key).getValue(), SCORE_NONE );
+
+	tt.store(key, 0, typeExact, 0, 0x4321, 0);
+	ttEntry e = tt.probe(key);
+	EXPECT_EQ( e.getType(), typeExact );
+	EXPECT_EQ( e.getPackedMove(), 0x4321 );
+}
+
+/* a refresh only updates the generation of the entry it has read, never a newer one written in the meantime */
+TEST(TranspositionTable, refreshKeepsNewerEntry)
+{
+	transpositionTable tt;
+	tt.setSize(1);
+	const U64 key = getTestKey(3);
+
+	tt.store(key, 100, typeExact, 5, 0x111, 7);
+	const ttEntry old = tt.probe(key);
+	const unsigned char oldGeneration = old.getGeneration();
+
+	tt.newSearch();
+	tt.refresh(old);
+	ttEntry e = tt.probe(key);
+	EXPECT_NE( e.getGeneration(), oldGeneration );
+	EXPECT_EQ( e.getValue(), 100 );
+	EXPECT_EQ( e.getDepth(), 5 );
+	EXPECT_EQ( e.getPackedMove(), 0x111 );
+	EXPECT_EQ( e.getStaticValue(), 7 );
+	EXPECT_EQ( e.getType(), typeExact );
+
+	// another search writes the slot: the old copy can't overwrite it
+	tt.newSearch();
+	tt.store(key, -200, typeScoreHigherThanBeta, 9, 0x222, -3);
+	tt.newSearch();
+	tt.refresh(old);
+	e = tt.probe(key);
+	EXPECT_EQ( e.getValue(), -200 );
+	EXPECT_EQ( e.getDepth(), 9 );
+	EXPECT_EQ( e.getPackedMove(), 0x222 );
+	EXPECT_EQ( e.getType(), typeScoreHigherThanBeta );
+	const unsigned char storeGeneration = e.getGeneration();
+
+	tt.refresh(e);
+	EXPECT_NE( tt.probe(key).getGeneration(), storeGeneration );
+	EXPECT_EQ( tt.probe(key).getPackedMove(), 0x222 );
+}
+
+TEST(TranspositionTable, sizeMB)
+{
+	transpositionTable tt;
+	tt.setSize(16);
+	EXPECT_EQ( tt.getSizeMB(), 16ul );
+	tt.setSize(3);
+	EXPECT_EQ( tt.getSizeMB(), 3ul );
+}
+
+TEST(TranspositionTable, noTornEntries)
+{
+	transpositionTable tt;
+	tt.setSize(1);
+
+	const unsigned int threadNumber = 8;
+	const unsigned int iterations = 200000;
+	std::atomic<unsigned long long> hits(0);
+	std::atomic<unsigned long long> tornEntries(0);
+
+	auto worker = [&](unsigned int seed)
+	{
+		std::mt19937 rng(seed);
+		for(unsigned int n = 0; n < iterations; n++)
+		{
+			unsigned int i = rng() % keyNumber;
+			U64 key = getTestKey(i);
+			if( rng() & 1 )
+			{
+				unsigned int v = rng() % variantNumber;
+				tt.store(key, getTestValue(i, v), getTestType(v), getTestDepth(v), getTestMove(v), getTestStaticValue(i, v));
+			}
+			else
+			{
+				const ttEntry e = tt.probe(key);
+				if( e.getKey() == ttSlot::getKeyCheck(key) )
+				{
+					++hits;
+					unsigned int v = e.getPackedMove() - 1;
+					if( v >= variantNumber
+						|| e.getValue() != getTestValue(i, v)
+						|| e.getStaticValue() != getTestStaticValue(i, v)
+						|| e.getDepth() != getTestDepth(v)
+						|| e.getType() != getTestType(v) )
+					{
+						++tornEntries;
+					}
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(unsigned int t = 0; t < threadNumber; t++)
+	{
+		threads.emplace_back(worker, t + 1);
+	}
+	for(auto& t: threads)
+	{
+		t.join();
+	}
+
+	EXPECT_GT( hits.load(), 0ull );
+	EXPECT_EQ( tornEntries.load(), 0ull );
+}
+
+template<class Policy>
+static void checkReplacementPolicy()
+{
+	transpositionTable tt;
+	tt.setSize(1);
+
+	// more positions than slots in the same cluster, each stored position must be found immediately after
+	for(unsigned int i = 0; i < keyNumber; i++)
+	{
+		U64 key = getTestKey(i);
+		tt.store<Policy>(key, getTestValue(i, i), getTestType(i), getTestDepth(i * 37), getTestMove(i), getTestStaticValue(i, i));
+		ttEntry e = tt.probe(key);
+		EXPECT_EQ( e.getKey(), ttSlot::getKeyCheck(key) );
+		EXPECT_EQ( e.getPackedMove(), getTestMove(i) );
+	}
+}
+
+TEST(TranspositionTable, replacementPolicies)
+{
+	checkReplacementPolicy<defaultReplacement>();
+	checkReplacementPolicy<depthPreferredReplacement>();
+	checkReplacementPolicy<agingDepthReplacement>();
+	checkReplacementPolicy<alwaysReplaceSecondReplacement>();
+	checkReplacementPolicy<qsearchPartitionReplacement>();
+}
+
+TEST(TranspositionTable, qsearchPartition)
+{
+	transpositionTable tt;
+	tt.setSize(1);
+
+	// fill the main search half with deep entries, then flood the cluster with quiescence entries
+	tt.store<qsearchPartitionReplacement>(getTestKey(0), 10, typeExact, 20 * ONE_PLY, 1, 0);
+	tt.store<qsearchPartitionReplacement>(getTestKey(1), 20, typeExact, 18 * ONE_PLY, 2, 0);
+	for(unsigned int i = 2; i < keyNumber; i++)
+	{
+		tt.store<qsearchPartitionReplacement>(getTestKey(i), 0, typeScoreHigherThanBeta, -ONE_PLY, 3, 0);
+	}
+	EXPECT_EQ( tt.probe(getTestKey(0)).getPackedMove(), 1 );
+	EXPECT_EQ( tt.probe(getTestKey(1)).getPackedMove(), 2 );
+}
+
+TEST(EvalTable, storeAndProbe)
+{
+	evalTable et;
+	Score s = 0;
+
+	// disabled table
+	et.setSize(0);
+	et.store(getTestKey(1), 100);
+	EXPECT_FALSE( et.probe(getTestKey(1), s) );
+	EXPECT_EQ( et.getProbes(), 0u );
+
+	et.setSize(1);
+	EXPECT_FALSE( et.probe(getTestKey(1), s) );
+	et.store(getTestKey(1), -1234);
+	EXPECT_TRUE( et.probe(getTestKey(1), s) );
+	EXPECT_EQ( s, -1234 );
+
+	// same entry, different upper bits: the newest position replaces the old one
+	et.store(getTestKey(2), 55);
+	EXPECT_FALSE( et.probe(getTestKey(1), s) );
+	EXPECT_TRUE( et.probe(getTestKey(2), s) );
+	EXPECT_EQ( s, 55 );
+
+	EXPECT_EQ( et.getProbes(), 4u );
+	EXPECT_EQ( et.getHits(), 2u );
+
+	et.clear();
+	EXPECT_FALSE( et.probe(getTestKey(2), s) );
+	EXPECT_EQ( et.getHits(), 0u );
+}
+
+TEST(PawnTable, allocation)
+{
+	pawnTable pt;
+	EXPECT_EQ( pt.probe(getTestKey(1)), nullptr );
+
+	pt.setSize(1);
+	EXPECT_EQ( pt.getSize(), 8192u );
+	pawnEntry* e = pt.probe(getTestKey(1));
+	ASSERT_NE( e, nullptr );
+	EXPECT_EQ( reinterpret_cast<uintptr_t>(pt.probe(0)) % 64, 0u );
+	EXPECT_NE( e->key, getTestKey(1) );
+
+	pt.insert(getTestKey(1), simdScore{10, -20, 0, 0}, 1, 2, 3, 4, 5, 6, 7, 8);
+	e = pt.probe(getTestKey(1));
+	EXPECT_EQ( e->key, getTestKey(1) );
+	EXPECT_EQ( e->res[0], 10 );
+	EXPECT_EQ( e->res[1], -20 );
+	EXPECT_EQ( e->holes[1], 8u );
+
+	// same size: the table is kept
+	pt.setSize(1);
+	EXPECT_EQ( pt.probe(getTestKey(1))->key, getTestKey(1) );
+
+	pt.setSize(16);
+	EXPECT_EQ( pt.getSize(), 131072u );
+	EXPECT_EQ( reinterpret_cast<uintptr_t>(pt.probe(0)) % 64, 0u );
+	EXPECT_NE( pt.probe(getTestKey(1))->key, getTestKey(1) );
+}
+
+/* the evaluation of a searcher, which uses its material table, is the same as without them */
+TEST(MaterialTable, sameEval)
+{
+	Position::initMaterialKeys();
+	const std::vector<std::string> fens = {
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+		"4k3/8/8/8/8/8/8/1Q2K3 w - - 0 1",
+		"4k3/8/8/3b4/8/8/5B2/4K3 b - - 0 1",
+		"2nbk3/8/8/8/8/8/8/1Q1RK3 w - - 0 1",
+		"1rnbk3/8/8/8/8/8/8/1Q2K3 b - - 0 1"
+	};
+	Search src;
+	for( unsigned int i = 0; i < 2; ++i )
+	{
+		for( const auto& fen: fens )
+		{
+			Position pos;
+			pos.setupFromFen(fen);
+			src.pos.setupFromFen(fen);
+			EXPECT_EQ( src.pos.eval<false>(), pos.eval<false>() ) << fen;
+		}
+	}
+}
@@ -15,6 +15,7 @@
     along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
 */
 
+#include <climits>
 #include "thread.h"
 #include "io.h"
 #include "search.h"
@@ -63,7 +64,7 @@ void timeManagerInit(const Position& pos, searchLimits& lim, timeManagementStruc
 			timeMan.allocatedTime = time / lim.movesToGo;
 			timeMan.maxAllocatedTime = 10.0 * timeMan.allocatedTime;
 			timeMan.maxAllocatedTime = std::min(10.0 * timeMan.allocatedTime, 0.8 * time);
-			timeMan.maxAllocatedTime = std::max(timeMan.maxAllocatedTime,timeMan.allocatedTime);
+			timeMan.maxAllocatedTime = std::max(timeMan.maxAllocatedTime.load(),timeMan.allocatedTime.load());
 		}
 		else
 		{
@@ -92,8 +93,8 @@ void timeManagerInit(const Position& pos, searchLimits& lim, timeManagementStruc
 }
 
 
-volatile bool my_thread::quit = false;
-volatile bool my_thread::startThink = false;
+std::atomic<bool> my_thread::quit(false);
+std::atomic<bool> my_thread::startThink(false);
 
 
 timeManagementStruct my_thread::timeMan;
@@ -106,18 +107,69 @@ my_thread * my_thread::pInstance;
 std::mutex  my_thread::_mutex;
 
 
+/*! \brief return the next time (ms from the start of the search) at which a time rule can fire
+	LLONG_MAX means that only an event (end of iteration, stop, ponderhit) can change the state
+*/
+long long int getNextCheckTime(long long int time, const searchLimits& lim, const timeManagementStruct& timeMan, long long int lastHasfullMessage)
+{
+	long long int next = LLONG_MAX;
+	auto consider = [&](long long int t)
+	{
+		if( t > time )
+		{
+			next = std::min( next, t );
+		}
+	};
+
+#ifndef DISABLE_TIME_DIPENDENT_OUTPUT
+	consider( lastHasfullMessage + 1001 );
+#else
+	(void)lastHasfullMessage;
+#endif
+	if( !(lim.infinite || lim.ponder) )
+	{
+		consider( timeMan.minSearchTime );
+		consider( (long long int)std::ceil( timeMan.allocatedTime * 0.7 ) );
+		consider( timeMan.allocatedTime );
+		consider( timeMan.maxAllocatedTime );
+	}
+	if( lim.moveTime )
+	{
+		consider( lim.moveTime );
+	}
+	return next;
+}
+
+long long int my_thread::getNextCheckTime(long long int time) const
+{
+	return ::getNextCheckTime( time, src.limits, timeMan, lastHasfullMessage );
+}
+
 void my_thread::timerThread()
 {
-	std::mutex mutex;
 	while (!quit)
 	{
 
-		std::unique_lock<std::mutex> lk(mutex);
+		std::unique_lock<std::mutex> lk(searchMutex);
 
 		timerCond.wait(lk, [&]{return (startThink && src.stop==false ) || quit;} );
 		if (!quit)
 		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(timeMan.resolution));
+			// sleep until the next deadline or until the search signals a new event
+			const long long int now = src.getClockTime();
+			const long long int next = getNextCheckTime(now);
+			auto event = [&]{ return quit || src.stop || !startThink || timeMan.idLoopIterationFinished || limitsChanged; };
+			if( next == LLONG_MAX )
+			{
+				timerCond.wait(lk, event);
+			}
+			else
+			{
+				timerCond.wait_until(lk, std::chrono::steady_clock::now() + std::chrono::milliseconds( next - now ), event);
+			}
+			limitsChanged = false;
+			lk.unlock();
+
 			long long int time = src.getClockTime();
 
 			if(timeMan.idLoopIterationFinished)
@@ -126,7 +178,7 @@ void my_thread::timerThread()
 			}
 			if(!src.stop && time >= timeMan.allocatedTime && ( timeMan.idLoopAlpha || timeMan.idLoopBeta ) )
 			{
-				timeMan.allocatedTime = timeMan.maxAllocatedTime;
+				timeMan.allocatedTime = timeMan.maxAllocatedTime.load();
 				//sync_cout<<"info debug EXTEND TIME: "<<timeMan.allocatedTime<<sync_endl;
 			}
 			if(!src.stop && timeMan.maxAllocatedTime == timeMan.allocatedTime /*&& time >= timeMan.allocatedTime */&& ( timeMan.idLoopIterationFinished ) && !(src.limits.infinite || src.limits.ponder) )
@@ -192,17 +244,15 @@ void my_thread::timerThread()
 			}
 			timeMan.idLoopIterationFinished = false;
 		}
-		lk.unlock();
 	}
 }
 
 void my_thread::searchThread()
 {
-	std::mutex mutex;
 	while (!quit)
 	{
 
-		std::unique_lock<std::mutex> lk(mutex);
+		std::unique_lock<std::mutex> lk(searchMutex);
 		searchCond.wait(lk, [&]{return startThink||quit;} );
 		if(!quit)
 		{
@@ -210,15 +260,27 @@ void my_thread::searchThread()
 			src.stop = false;
 			src.resetStartTime();
 			src.resetPonderTime();
+			lk.unlock();
 			timerCond.notify_one();
-			src.stop = false;
+
 			manageNewSearch();
+
+			lk.lock();
 			startThink = false;
+			lk.unlock();
+			stateCond.notify_all();
+			timerCond.notify_one();
 		}
-		lk.unlock();
 	}
 }
 
+/*! \brief block until the gui allows to send the bestmove: the ponder phase is finished and, if waitInfinite is set, an infinite search has been stopped*/
+void my_thread::waitStopOrPonderHit(bool waitInfinite)
+{
+	std::unique_lock<std::mutex> lk(searchMutex);
+	stateCond.wait(lk, [&]{ return !src.limits.ponder && !( waitInfinite && src.limits.infinite && !src.stop ); });
+}
+
 void my_thread::manageNewSearch()
 {
 
@@ -242,7 +304,7 @@ void my_thread::manageNewSearch()
 
 	if(legalMoves == 0)
 	{
-		while((src.limits.infinite && !src.stop) || src.limits.ponder){}
+		waitStopOrPonderHit(true);
 
 		sync_cout<<"info depth 0 score cp 0"<<sync_endl;
 		sync_cout<<"bestmove 0000"<<sync_endl;
@@ -255,13 +317,13 @@ void my_thread::manageNewSearch()
 		{
 			Move m = mg.getMoveFromMoveList(0);
 			sync_cout << "info pv " << displayUci(m) << sync_endl;
-			while(src.limits.ponder){}
+			waitStopOrPonderHit(false);
 			sync_cout << "bestmove " << displayUci(m);
 
 			src.pos.doMove(m);
-			const ttEntry* const tte = TT.probe(src.pos.getKey());
+			const ttEntry tte = TT.probe(src.pos.getKey());
 			
-			m.packed = tte->getPackedMove();
+			m.packed = tte.getPackedMove();
 			if( src.pos.isMoveLegal(m) )
 			{
 				std::cout<<" ponder "<<displayUci(m)<<sync_endl;
@@ -286,7 +348,7 @@ void my_thread::manageNewSearch()
 		if(bookM.packed)
 		{
 			sync_cout << "info pv " << displayUci(bookM) << sync_endl;
-			while( (src.limits.infinite && !src.stop) || src.limits.ponder){}
+			waitStopOrPonderHit(true);
 			sync_cout<<"bestmove "<< displayUci(bookM) << sync_endl;
 			return;
 		}
@@ -299,15 +361,22 @@ void my_thread::manageNewSearch()
 	{
 		sync_cout<<"info debug PONDER WRONG"<<sync_endl;
 	}*/
+	if( perfCounters::enabled )
+	{
+		perf.start();
+	}
 	res = src.startThinking();
+	if( perfCounters::enabled )
+	{
+		perf.stop();
+		sync_cout << perf.toInfoString() << sync_endl;
+	}
 
 
 
-	std::list<Move> PV = res.PV;
+	const PVline& PV = res.PV;
 
-	while(src.limits.ponder)
-	{
-	}
+	waitStopOrPonderHit(false);
 
 	//-----------------------------
 	// print out the choosen line
@@ -316,18 +385,18 @@ void my_thread::manageNewSearch()
 
 	if(PV.size() > 1)
 	{
-		std::list<Move>::iterator it = PV.begin();
+		PVline::const_iterator it = PV.begin();
 		std::advance(it, 1);
 		std::cout<<" ponder "<<displayUci(*it)<<sync_endl;
 	}
 	else
 	{
 		src.pos.doMove( PV.front() );
-		const ttEntry* const tte = TT.probe(src.pos.getKey());
+		const ttEntry tte = TT.probe(src.pos.getKey());
 		
 
 		Move m;
-		m.packed = tte->getPackedMove();
+		m.packed = tte.getPackedMove();
 		if( src.pos.isMoveLegal(m) )
 		{
 			std::cout<<" ponder "<<displayUci(m)<<sync_endl;
@@ -357,9 +426,13 @@ void my_thread::initThreads()
 
 void my_thread::quitThreads()
 {
-	quit = true;
+	{
+		std::lock_guard<std::mutex> lk(searchMutex);
+		quit = true;
+	}
 	searchCond.notify_one();
 	timerCond.notify_one();
+	stateCond.notify_all();
 	timer.join();
 	searcher.join();
 }
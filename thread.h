@@ -22,30 +22,38 @@
 #include <mutex>
 #include <chrono>
 #include <condition_variable>
+#include <atomic>
 #include "position.h"
 #include "search.h"
 #include "transposition.h"
 #include "command.h"
 #include "movegen.h"
+#include "perfcounters.h"
 
 
 
 struct timeManagementStruct
 {
-	volatile long long allocatedTime;
-	volatile long long minSearchTime;
-	volatile long long maxAllocatedTime;
-	volatile unsigned int depth;
-	volatile unsigned int singularRootMoveCount;
-	volatile unsigned int resolution;
-	volatile bool idLoopIterationFinished;
-	volatile bool idLoopAlpha;
-	volatile bool idLoopBeta;
+	std::atomic<long long> allocatedTime;
+	std::atomic<long long> minSearchTime;
+	std::atomic<long long> maxAllocatedTime;
+	std::atomic<unsigned int> depth;
+	std::atomic<unsigned int> singularRootMoveCount;
+	std::atomic<unsigned int> resolution;
+	std::atomic<bool> idLoopIterationFinished;
+	std::atomic<bool> idLoopAlpha;
+	std::atomic<bool> idLoopBeta;
 //
-	bool FirstIterationFinished;
+	std::atomic<bool> FirstIterationFinished;
 
 };
 
+/*! \brief compute the time allocated to the search from the limits of the go command
+	a go command without time limits becomes an infinite search
+*/
+void timeManagerInit(const Position& pos, searchLimits& lim, timeManagementStruct& timeMan);
+long long int getNextCheckTime(long long int time, const searchLimits& lim, const timeManagementStruct& timeMan, long long int lastHasfullMessage);
+
 
 class Game
 {
@@ -82,7 +90,7 @@ public:
 		}
 	}
 
-	void savePV(std::list<Move> PV,unsigned int depth, Score alpha, Score beta)
+	void savePV(const PVline& PV,unsigned int depth, Score alpha, Score beta)
 	{
 		std::copy(std::begin(PV), std::end(PV), std::back_inserter(positions.back().PV));
 		positions.back().depth = depth;
@@ -174,14 +182,17 @@ class my_thread
 	static my_thread * pInstance;
 
 
-	volatile static bool quit;
-	volatile static bool startThink;
+	static std::atomic<bool> quit;
+	static std::atomic<bool> startThink;
 	std::thread timer;
 	std::thread searcher;
 	std::mutex searchMutex;
 	std::condition_variable searchCond;
 	std::condition_variable timerCond;
+	std::condition_variable stateCond;	/*! notified when the search ends, is stopped or the ponder phase finishes*/
+	bool limitsChanged = false;	/*! set by ponderhit under searchMutex: the timer shall compute its deadlines again*/
 	Search src;
+	perfCounters perf;	/*!< opened by the search thread, they count only the main searcher*/
 
 	static long long lastHasfullMessage;
 
@@ -191,6 +202,8 @@ class my_thread
 	void timerThread();
 	void searchThread();
 	void manageNewSearch();
+	void waitStopOrPonderHit(bool waitInfinite);
+	long long int getNextCheckTime(long long int time) const;
 public :
 	void quitThreads();
 
@@ -223,28 +236,71 @@ public :
 		src.stop = true;
 		lastHasfullMessage = 0;
 
-		while(startThink){}
+		// wait for the end of the previous search
+		std::unique_lock<std::mutex> lk(searchMutex);
+		stateCond.wait(lk, [&]{ return !startThink; });
+
+		src.limits = l;
+		src.pos = *p;
+		limitsChanged = false;
+		startThink = true;
+		searchCond.notify_one();
+	}
+
+	/*! \brief the main searcher, of the running or of the last search*/
+	const Search& getSearch() const
+	{
+		return src;
+	}
+
+	/*! \brief a search (or a ponder search) is running and has not sent its bestmove yet*/
+	bool isSearching() const
+	{
+		return startThink;
+	}
+
+	/*! \brief block until the running search, if any, has sent its bestmove*/
+	void waitSearchEnd()
+	{
+		std::unique_lock<std::mutex> lk(searchMutex);
+		stateCond.wait(lk, [&]{ return !startThink; });
+	}
 
-		if(!startThink)
+	void stopThinking()
+	{
 		{
 			std::lock_guard<std::mutex> lk(searchMutex);
-			src.limits = l;
-			src.pos = *p;
-			startThink = true;
-			searchCond.notify_one();
+			src.stop = true;
+			src.stopPonder();
 		}
+		stateCond.notify_all();
+		timerCond.notify_one();
 	}
 
-	void stopThinking()
+	void ponderHit()
 	{
-		src.stop = true;
-		src.stopPonder();
+		{
+			std::lock_guard<std::mutex> lk(searchMutex);
+			src.resetPonderTime();
+			src.stopPonder();
+			limitsChanged = true;
+		}
+		stateCond.notify_all();
+		// the deadlines restart from now
+		timerCond.notify_one();
 	}
 
-	void ponderHit()
+	/*! \brief wake up the timer thread, called by the search at the end of every iteration*/
+	static void wakeUpTimer()
 	{
-		src.resetPonderTime();
-		src.stopPonder();
+		if( pInstance )
+		{
+			// empty critical section: the timer is either before its predicate check or already waiting
+			{
+				std::lock_guard<std::mutex> lk(pInstance->searchMutex);
+			}
+			pInstance->timerCond.notify_one();
+		}
 	}
 
 };
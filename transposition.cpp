@@ -15,89 +15,501 @@
     along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
 */
 
+#include <new>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <mutex>
+#include <list>
 #include "transposition.h"
 #include "io.h"
+#include "hashKeys.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
 
 
 transpositionTable TT;
 
-unsigned long int transpositionTable::setSize(unsigned long int mbSize)
+/*! \brief allocate a zone of memory aligned to a given size
+	big tables are aligned to the huge page size and the kernel is asked to back them with transparent huge pages
+*/
+static void* allocateAligned(size_t size, size_t alignment)
 {
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* mem = nullptr;
+	if( posix_memalign(&mem, alignment, size) )
+	{
+		return nullptr;
+	}
+	return mem;
+#endif
+}
 
-	long long unsigned int size = (long unsigned int)( ((unsigned long long int)mbSize << 20) / sizeof(ttCluster));
-	elements = size;
+static void freeAligned(void* mem)
+{
+#ifdef _WIN32
+	_aligned_free(mem);
+#else
+	free(mem);
+#endif
+}
 
-	table.clear();
-	table.shrink_to_fit();
-	try
+static bool adviseHugePages(void* mem, size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	return madvise(mem, size, MADV_HUGEPAGE) == 0;
+#else
+	(void)mem;
+	(void)size;
+	return false;
+#endif
+}
+
+/*! \brief bytes of the mappings overlapping [mem, mem + size) that are backed by transparent huge pages
+	madvise only tells that the hint has been accepted, the pages really obtained are read from /proc/self/smaps
+*/
+static unsigned long long getHugePagesBytes(const void* mem, size_t size)
+{
+	unsigned long long total = 0;
+#ifdef __linux__
+	const unsigned long long begin = (unsigned long long)(uintptr_t)mem;
+	const unsigned long long end = begin + size;
+	std::ifstream smaps("/proc/self/smaps");
+	std::string line;
+	bool inside = false;
+	while( std::getline(smaps, line) )
 	{
-		table.resize(elements);
+		std::istringstream is(line);
+		std::string token;
+		is >> token;
+		const size_t dash = token.find('-');
+		if( dash != std::string::npos && token.back() != ':' )
+		{
+			// mapping header: "from-to perms offset dev inode path"
+			try
+			{
+				const unsigned long long from = std::stoull(token.substr(0, dash), nullptr, 16);
+				const unsigned long long to = std::stoull(token.substr(dash + 1), nullptr, 16);
+				inside = from < end && to > begin;
+			}
+			catch(...)
+			{
+				inside = false;
+			}
+		}
+		else if( inside && token == "AnonHugePages:" )
+		{
+			unsigned long long kB = 0;
+			is >> kB;
+			total += kB * 1024;
+		}
 	}
-	catch(...)
+#else
+	(void)mem;
+	(void)size;
+#endif
+	return total;
+}
+
+void transpositionTable::freeTable()
+{
+	if( table )
+	{
+		freeAligned(table);
+		table = nullptr;
+	}
+	hugePagesBytes = 0;
+}
+
+/*! \brief construct (zero) all the clusters splitting the work between threads
+	the first touch of the pages is also spread, so the page faults of a big table are served in parallel
+*/
+void transpositionTable::initClusters(unsigned int threads)
+{
+	threads = std::max(1u, threads);
+	const unsigned long int chunk = ( elements + threads - 1 ) / threads;
+
+	auto worker = [this, chunk](unsigned int i)
+	{
+		const unsigned long int start = std::min( elements, i * chunk );
+		const unsigned long int end = std::min( elements, start + chunk );
+		for(unsigned long int n = start; n < end; n++)
+		{
+			new (&table[n]) ttCluster();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(unsigned int i = 1; i < threads; i++)
+	{
+		workers.emplace_back(worker, i);
+	}
+	worker(0);
+	for(auto& t: workers)
+	{
+		t.join();
+	}
+}
+
+void transpositionTable::clear(unsigned int threads)
+{
+	if( table )
+	{
+		initClusters(threads);
+	}
+	generation = 0;
+}
+
+unsigned long int transpositionTable::setSize(unsigned long int mbSize, unsigned int threads, bool useHugePages)
+{
+	static const size_t cacheLineSize = 64;
+	static const size_t hugePageSize = 2 * 1024 * 1024;
+
+	long long unsigned int size = (long unsigned int)( ((unsigned long long int)mbSize << 20) / sizeof(ttCluster));
+	elements = size;
+
+	freeTable();
+
+	const size_t bytes = elements * sizeof(ttCluster);
+	const bool bigTable = bytes >= hugePageSize;
+	table = static_cast<ttCluster*>( allocateAligned( bytes, bigTable ? hugePageSize : cacheLineSize ) );
+	if( !table )
 	{
 		std::cerr << "Failed to allocate " << mbSize<< "MB for transposition table." << std::endl;
 		exit(EXIT_FAILURE);
 	}
-	return elements * 4;
+	// ask for huge pages before touching the memory, the kernel will fall back to normal pages if it can't
+	const bool advised = useHugePages && bigTable && adviseHugePages( table, bytes );
+
+	initClusters(threads);
+	// the pages are assigned by the first touch, so they are checked after the clusters have been zeroed
+	hugePagesBytes = advised ? getHugePagesBytes( table, bytes ) : 0;
+	generation = 0;
+	return elements * ttClusterSize;
 }
 
 
-static ttEntry null(0,SCORE_NONE, typeVoid, -100, 0, 0, 0);
-ttEntry* transpositionTable::probe(const U64 key)
+//---------------------------------------------
+//	hash file persistence
+//---------------------------------------------
+
+struct ttFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t generation;
+	uint64_t elements;
+	uint64_t keySignature;
+};
+
+static const char ttFileMagic[8] = {'V','A','J','O','L','E','T','H'};
+// the version identifies the layout of the clusters too
+#ifdef ENABLE_TT_COMPACT_ENTRIES
+static const uint32_t ttFileVersion = 4;
+#else
+static const uint32_t ttFileVersion = 3;
+#endif
+static const size_t ttFileChunkSize = 64 * 1024 * 1024;
+
+/*! \brief dump the whole table to a file
+	the table is written as it is in memory, in big sequential chunks
+*/
+bool transpositionTable::save(const std::string& fileName) const
+{
+	if( !table )
+	{
+		return false;
+	}
+
+	std::ofstream ofs(fileName, std::ios::binary | std::ios::trunc);
+	if( !ofs.is_open() )
+	{
+		return false;
+	}
+
+	ttFileHeader header;
+	std::copy(std::begin(ttFileMagic), std::end(ttFileMagic), header.magic);
+	header.version = ttFileVersion;
+	header.generation = generation;
+	header.elements = elements;
+	header.keySignature = HashKeys::getSignature();
+	ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	const char* data = reinterpret_cast<const char*>(table);
+	size_t remaining = elements * sizeof(ttCluster);
+	while( remaining && ofs.good() )
+	{
+		size_t n = std::min(remaining, ttFileChunkSize);
+		ofs.write(data, n);
+		data += n;
+		remaining -= n;
+	}
+	return ofs.good();
+}
+
+/*! \brief reload a table saved with save()
+	the table is resized to the saved size if needed. an invalid file leave the table untouched.
+*/
+bool transpositionTable::load(const std::string& fileName, unsigned int threads)
+{
+	std::ifstream ifs(fileName, std::ios::binary);
+	if( !ifs.is_open() )
+	{
+		return false;
+	}
+
+	ttFileHeader header;
+	if( !ifs.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| !std::equal(std::begin(ttFileMagic), std::end(ttFileMagic), header.magic)
+		|| header.version != ttFileVersion
+		|| header.keySignature != HashKeys::getSignature()
+		|| header.elements == 0
+		|| ( ( header.elements * sizeof(ttCluster) ) & ( ( 1 << 20 ) - 1 ) ) )
+	{
+		return false;
+	}
+
+	// check the file length before destroying the actual table
+	const std::streampos dataStart = ifs.tellg();
+	ifs.seekg(0, std::ios::end);
+	if( (unsigned long long)( ifs.tellg() - dataStart ) != header.elements * sizeof(ttCluster) )
+	{
+		return false;
+	}
+	ifs.seekg(dataStart);
+
+	if( header.elements != elements || !table )
+	{
+		setSize( (unsigned long int)( ( header.elements * sizeof(ttCluster) ) >> 20 ), threads, true );
+	}
+
+	char* data = reinterpret_cast<char*>(table);
+	size_t remaining = elements * sizeof(ttCluster);
+	while( remaining )
+	{
+		size_t n = std::min(remaining, ttFileChunkSize);
+		if( !ifs.read(data, n) )
+		{
+			clear(threads);
+			return false;
+		}
+		data += n;
+		remaining -= n;
+	}
+	generation = (unsigned char)( header.generation & ttSlot::generationMask );
+	return true;
+}
+
+
+static const ttEntry null(0,SCORE_NONE, typeVoid, -100, 0, 0, 0);
+ttEntry transpositionTable::probe(const U64 key)
 {
 
 
 	ttCluster& ttc = findCluster(key);
-	unsigned int keyH = (unsigned int)(key >> 32);
+	unsigned int keyH = ttSlot::getKeyCheck(key);
+
+#ifdef ENABLE_TT_STATISTICS
+	ttStatistics& stats = ttStatistics::local();
+	ttStatistics::increment( stats.probes );
+#endif
 
-	auto it = std::find_if (ttc.begin(), ttc.end(), [keyH](ttEntry p){return p.getKey()==keyH;});
-	if( it != ttc.end())
+	for(auto& slot: ttc)
 	{
-		return it;
+		ttEntry e = slot.load();
+		if( e.getKey() == keyH && e.getType() != typeVoid )
+		{
+#ifdef ENABLE_TT_STATISTICS
+			ttStatistics::increment( stats.hits );
+#endif
+			e.slot = &slot;
+			return e;
+		}
 	}
 
-	return &null;
+	return null;
 }
 
 
+template<class ReplacementPolicy>
 void transpositionTable::store(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue)
 {
 
+	assert(value < SCORE_INFINITE || value == SCORE_NONE);
+	assert(value >- SCORE_INFINITE);
+	assert(statValue < SCORE_INFINITE);
+	assert(statValue > -SCORE_INFINITE);
+	assert(type <= typeScoreHigherThanBeta);
 
-	ttEntry *candidate;
-	unsigned int keyH = (unsigned int)(key >> 32); // Use the high 32 bits as key inside the cluster
+	unsigned int keyH = ttSlot::getKeyCheck(key); // Use the high bits as key inside the cluster
 
 	ttCluster& ttc = findCluster(key);
 
-	auto it = std::find_if (ttc.begin(), ttc.end(), [keyH](ttEntry p){return (!p.getKey()) || (p.getKey()==keyH);});
-	if( it != ttc.end())
+	// take a snapshot of the cluster, each entry is verified on load
+	ttClusterEntries entries;
+	for(unsigned int i = 0; i < ttc.size(); i++)
+	{
+		entries[i] = ttc[i].load();
+	}
+
+	unsigned int candidate = ReplacementPolicy::selectSlot(entries, keyH, depth, generation);
+	assert(candidate < entries.size());
+
+#ifdef ENABLE_TT_STATISTICS
+	ttStatistics& stats = ttStatistics::local();
+	ttStatistics::increment( stats.stores );
+	const ttEntry& old = entries[candidate];
+	if( !old.getKey() )
+	{
+		ttStatistics::increment( stats.emptySlotStores );
+	}
+	else if( old.getKey() == keyH )
 	{
-		candidate = it;
+		ttStatistics::increment( stats.updates );
 	}
 	else
 	{
-		candidate = &ttc[0];
-		for(auto& d: ttc)
+		ttStatistics::increment( stats.replacements );
+		ttStatistics::increment( stats.replacedDepth[ ttStatistics::getDepthBucket( old.getDepth() ) ] );
+		if( old.getGeneration() == generation )
 		{
-			bool cc1,cc2,cc3,cc4;
+			ttStatistics::increment( stats.sameGenerationOverwrites );
+		}
+	}
+#endif
 
-			cc1 = candidate->getGeneration() == generation;
-			cc2 = d.getGeneration() == generation;
-			cc3 = d.getType() == typeExact;
-			cc4 = d.getDepth() < candidate->getDepth();
+	// don't overwrite the old move if we don't have a new one
+	if( !move )
+	{
+		move = entries[candidate].getPackedMove();
+	}
+	ttc[candidate].save( ttEntry(keyH, value, type, depth, move, statValue, generation) );
 
+}
 
-			if( (cc1 && cc4) || (!(cc2 || cc3) && (cc4 || cc1)) )
-			{
-				candidate = &d;
-			}
 
-		}
+template void transpositionTable::store<defaultReplacement>(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue);
+template void transpositionTable::store<depthPreferredReplacement>(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue);
+template void transpositionTable::store<agingDepthReplacement>(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue);
+template void transpositionTable::store<alwaysReplaceSecondReplacement>(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue);
+template void transpositionTable::store<qsearchPartitionReplacement>(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue);
+
+
+#ifdef ENABLE_TT_STATISTICS
+//---------------------------------------------
+//	statistics
+//---------------------------------------------
+
+void ttStatistics::add(const ttStatistics& other)
+{
+	auto sum = [](counter& a, const counter& b){ a.store( a.load() + b.load() ); };
+	sum( probes, other.probes );
+	sum( hits, other.hits );
+	sum( cutoffs, other.cutoffs );
+	sum( stores, other.stores );
+	sum( emptySlotStores, other.emptySlotStores );
+	sum( updates, other.updates );
+	sum( replacements, other.replacements );
+	sum( sameGenerationOverwrites, other.sameGenerationOverwrites );
+	for(unsigned int i = 0; i < depthBuckets; i++)
+	{
+		sum( replacedDepth[i], other.replacedDepth[i] );
+	}
+}
+
+void ttStatistics::clear()
+{
+	probes = 0;
+	hits = 0;
+	cutoffs = 0;
+	stores = 0;
+	emptySlotStores = 0;
+	updates = 0;
+	replacements = 0;
+	sameGenerationOverwrites = 0;
+	for(auto& c: replacedDepth)
+	{
+		c = 0;
 	}
-	assert(candidate != nullptr);
-	candidate->save(keyH, value, type, depth, move, statValue, generation);
+}
+
+/* counters of the running threads, and the sum of the counters of the terminated ones */
+static std::mutex statisticsMutex;
+static std::list<ttStatistics*> liveStatistics;
+static ttStatistics retiredStatistics;
+
+namespace
+{
+	struct ttStatisticsHolder
+	{
+		ttStatistics stats;
+		ttStatisticsHolder()
+		{
+			std::lock_guard<std::mutex> lock(statisticsMutex);
+			liveStatistics.push_back(&stats);
+		}
+		~ttStatisticsHolder()
+		{
+			std::lock_guard<std::mutex> lock(statisticsMutex);
+			retiredStatistics.add(stats);
+			liveStatistics.remove(&stats);
+		}
+	};
+}
+
+ttStatistics& ttStatistics::local()
+{
+	static thread_local ttStatisticsHolder holder;
+	return holder.stats;
+}
 
+void ttStatistics::reset()
+{
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	retiredStatistics.clear();
+	for(auto s: liveStatistics)
+	{
+		s->clear();
+	}
+}
 
+void ttStatistics::print()
+{
+	ttStatistics total;
+	{
+		std::lock_guard<std::mutex> lock(statisticsMutex);
+		total.add(retiredStatistics);
+		for(auto s: liveStatistics)
+		{
+			total.add(*s);
+		}
+	}
 
+	auto percent = [](unsigned long long a, unsigned long long b){ return b ? 100.0 * a / b : 0.0; };
 
+	sync_cout << "info string hash probes " << total.probes
+			<< " hits " << total.hits << " (" << percent(total.hits, total.probes) << "%)"
+			<< " cutoffs " << total.cutoffs << " (" << percent(total.cutoffs, total.hits) << "% of hits)" << sync_endl;
+	sync_cout << "info string hash stores " << total.stores
+			<< " empty slot " << total.emptySlotStores
+			<< " same key " << total.updates
+			<< " replaced " << total.replacements
+			<< " same generation overwrites " << total.sameGenerationOverwrites << sync_endl;
+	sync_cout << "info string hash replaced entries depth histogram:";
+	for(unsigned int i = 0; i < depthBuckets; i++)
+	{
+		if( total.replacedDepth[i] )
+		{
+			std::cout << " " << ( (int)i - 2 ) << ( i == depthBuckets - 1 ? "+" : "" ) << ":" << total.replacedDepth[i];
+		}
+	}
+	std::cout << sync_endl;
 }
+#endif
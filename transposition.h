@@ -23,6 +23,9 @@
 #include <cstring>
 #include <array>
 #include <vector>
+#include <atomic>
+#include <cstdint>
+#include <string>
 
 
 
@@ -36,45 +39,32 @@ enum ttType
 	typeVoid
 };
 
+class ttSlot;
+
 class ttEntry
 {
+	friend class transpositionTable;
 private:
 
-	signed int key:32; 			/*! 32 bit for the upper part of the key*/
-	signed int packedMove:16;	/*! 16 bit for the move*/
-	signed int depth:16;		/*! 16 bit for depth*/
-	signed int value:23;		/*! 23 bit for the value*/
-	signed int generation:8;		/*! 8 bit for the generation id*/
-	signed int staticValue:23;	/*! 23 bit for the static evalutation (eval())*/
-	signed int type:3;			/*! 2 bit for the type of the entry*/
-							/*  144 bits total =16 bytes*/
-public:
-	ttEntry(unsigned int _Key, Score _Value, unsigned char _Type, signed short int _Depth, unsigned short _Move, Score _StaticValue, unsigned char _gen): key(_Key),packedMove(_Move),depth(_Depth), value(_Value),generation(_gen),staticValue(_StaticValue),type(_Type){}
-	ttEntry(){}
+	unsigned int key; 			/*! 32 bit for the upper part of the key*/
+	unsigned short packedMove;	/*! 16 bit for the move*/
+	signed short int depth;		/*! 16 bit for depth*/
+	Score value;				/*! 23 bit for the value*/
+	unsigned char generation;	/*! 8 bit for the generation id*/
+	Score staticValue;			/*! 23 bit for the static evalutation (eval())*/
+	unsigned char type;			/*! 2 bit for the type of the entry*/
+	ttSlot* slot = nullptr;		/*! slot the entry has been read from, used by refresh*/
 
-	void save(unsigned int Key, Score Value, unsigned char Type, signed short int Depth, unsigned short Move, Score StaticValue, unsigned char gen)
-	{
-		assert(Value < SCORE_INFINITE || Value == SCORE_NONE);
-		assert(Value >- SCORE_INFINITE);
-		assert(StaticValue < SCORE_INFINITE);
-		assert(StaticValue > -SCORE_INFINITE);
-		assert(Type <= typeScoreHigherThanBeta);
-		key = Key;
-		value = Value;
-		staticValue = StaticValue;
-		if(Move)
-		{
-			packedMove = Move;
-		}
-		depth = Depth;
-		generation = gen;
-		type = Type;
-	}
-
-	void setGeneration(unsigned char gen)
+public:
+	ttEntry(unsigned int _Key, Score _Value, unsigned char _Type, signed short int _Depth, unsigned short _Move, Score _StaticValue, unsigned char _gen): key(_Key),packedMove(_Move),depth(_Depth), value(_Value),generation(_gen),staticValue(_StaticValue),type(_Type)
 	{
-		generation = gen;
+		assert(_Value < SCORE_INFINITE || _Value == SCORE_NONE);
+		assert(_Value >- SCORE_INFINITE);
+		assert(_StaticValue < SCORE_INFINITE);
+		assert(_StaticValue > -SCORE_INFINITE);
+		assert(_Type <= typeVoid);
 	}
+	ttEntry(){}
 
 	inline unsigned int getKey() const{ return key; }
 	Score getValue()const { return value; }
@@ -97,42 +87,536 @@ public:
 
 };
 
-typedef	std::array< ttEntry, 4> ttCluster;
+#ifdef ENABLE_TT_COMPACT_ENTRIES
+/*! \brief compact lock-free storage of a ttEntry
+	the entry is packed in three 32 bit words: 12 bytes instead of 16, so a cache line holds 5 entries instead of 4.
+	only 16 bits of the key are stored, the depth is limited to 11 bit and the generation to 5 bit.
+	as in the normal layout the key is xor-ed with a fold of the other words, so a torn entry is a miss,
+	and the type is xor-ed with typeVoid, so a cleared slot is never a hit.
+*/
+class ttSlot
+{
+private:
+	std::atomic<uint32_t> keyMove{0};	/*! key:16 move:16, key xor-ed with fold(data)*/
+	std::atomic<uint32_t> dataLow{0};	/*! low part of data: value:23 staticValue:9*/
+	std::atomic<uint32_t> dataHigh{0};	/*! high part of data: staticValue:14 type:2 generation:5 depth:11*/
+
+	static const unsigned int valueShift = 0;
+	static const unsigned int staticValueShift = 23;
+	static const unsigned int typeShift = 46;
+	static const unsigned int generationShift = 48;
+	static const unsigned int depthShift = 53;
+
+	static const signed short int maxDepth = 1023;
+
+	static inline uint32_t fold(const U64 d)
+	{
+		return (uint32_t)( d ^ ( d >> 16 ) ^ ( d >> 32 ) ^ ( d >> 48 ) ) & 0xFFFF;
+	}
+
+	static inline U64 packScore(const Score s, const unsigned int shift)
+	{
+		return ( (U64)(unsigned int)s & 0x7FFFFFull ) << shift;
+	}
+
+	static inline Score unpackScore(const U64 d, const unsigned int shift)
+	{
+		// sign extension of the 23 bit field
+		return (Score)( (signed long long int)( d << ( 64 - 23 - shift ) ) >> ( 64 - 23 ) );
+	}
+
+	static inline U64 packData(const ttEntry& e)
+	{
+		// deeper entries are stored as maxDepth, they will only be used by shallower searches
+		const signed short int depth = std::min( e.getDepth(), maxDepth );
+		return packScore( e.getValue(), valueShift )
+				| packScore( e.getStaticValue(), staticValueShift )
+				| ( (U64)( e.getType() ^ typeVoid ) << typeShift )
+				| ( (U64)( e.getGeneration() & generationMask ) << generationShift )
+				| ( (U64)(unsigned short)depth << depthShift );
+	}
+
+	static inline uint32_t packKey(const ttEntry& e)
+	{
+		return ( ( e.getKey() & 0xFFFF ) << 16 ) | e.getPackedMove();
+	}
+
+	inline void write(const uint32_t k, const U64 d)
+	{
+		keyMove.store( k ^ ( fold(d) << 16 ), std::memory_order_relaxed );
+		dataLow.store( (uint32_t)d, std::memory_order_relaxed );
+		dataHigh.store( (uint32_t)( d >> 32 ), std::memory_order_relaxed );
+	}
+
+public:
+
+	static const unsigned int generationMask = 0x1F;
+
+	/*! \brief the part of the hash key stored in the slot*/
+	static inline unsigned int getKeyCheck(const U64 key)
+	{
+		return (unsigned int)( key >> 48 );
+	}
+
+	inline void save(const ttEntry& e)
+	{
+		write( packKey(e), packData(e) );
+	}
+
+	/*! \brief set the generation of the entry e read from the slot, if the slot still holds it*/
+	inline void refresh(const ttEntry& e, const unsigned char generation)
+	{
+		const U64 d = packData(e);
+		const uint32_t k = packKey(e);
+		if( keyMove.load(std::memory_order_relaxed) == ( k ^ ( fold(d) << 16 ) )
+			&& dataLow.load(std::memory_order_relaxed) == (uint32_t)d
+			&& dataHigh.load(std::memory_order_relaxed) == (uint32_t)( d >> 32 ) )
+		{
+			write( k, ( d & ~( (U64)generationMask << generationShift ) ) | ( (U64)( generation & generationMask ) << generationShift ) );
+		}
+	}
+
+	inline ttEntry load() const
+	{
+		const U64 d = (U64)dataLow.load(std::memory_order_relaxed) | ( (U64)dataHigh.load(std::memory_order_relaxed) << 32 );
+		const uint32_t k = keyMove.load(std::memory_order_relaxed) ^ ( fold(d) << 16 );
+
+		return ttEntry( k >> 16,
+				unpackScore( d, valueShift ),
+				(unsigned char)( ( ( d >> typeShift ) & 0x3 ) ^ typeVoid ),
+				(signed short int)( (signed long long int)d >> depthShift ),
+				(unsigned short)( k & 0xFFFF ),
+				unpackScore( d, staticValueShift ),
+				(unsigned char)( ( d >> generationShift ) & generationMask ) );
+	}
+
+	inline void clear()
+	{
+		keyMove.store( 0, std::memory_order_relaxed );
+		dataLow.store( 0, std::memory_order_relaxed );
+		dataHigh.store( 0, std::memory_order_relaxed );
+	}
+};
+
+static const unsigned int ttClusterSize = 5;
+struct ttCluster: public std::array< ttSlot, ttClusterSize>
+{
+	uint32_t padding = 0;
+};
+static_assert(sizeof(ttSlot) == 12, "a compact slot is made of three 32 bit words");
+static_assert(sizeof(ttCluster) == 64, "a cluster should fill exactly one cache line");
+
+#else
+/*! \brief lock-free storage of a ttEntry
+	the entry is packed in two 64 bit words that are written and read atomically one by one.
+	the first word holds key, move and depth, xor-ed with a 32 bit fold of the second word (value, static value, generation, type).
+	a reader that sees the two words coming from different writes recovers a wrong key, so a torn entry is simply a miss.
+	the type is xor-ed with typeVoid, so a cleared slot decodes as typeVoid and is never a hit.
+*/
+class ttSlot
+{
+private:
+	std::atomic<U64> keyCheck{0};	/*! key:32 move:16 depth:16, key xor-ed with fold(data)*/
+	std::atomic<U64> data{0};		/*! value:23 staticValue:23 generation:8 type:3*/
+
+	static const unsigned int valueShift = 0;
+	static const unsigned int staticValueShift = 23;
+	static const unsigned int generationShift = 46;
+	static const unsigned int typeShift = 54;
+
+	static inline U64 fold(const U64 d)
+	{
+		return ( d ^ ( d >> 32 ) ) & 0xFFFFFFFFull;
+	}
+
+	static inline U64 packScore(const Score s, const unsigned int shift)
+	{
+		return ( (U64)(unsigned int)s & 0x7FFFFFull ) << shift;
+	}
+
+	static inline Score unpackScore(const U64 d, const unsigned int shift)
+	{
+		// sign extension of the 23 bit field
+		return (Score)( (signed long long int)( d << ( 64 - 23 - shift ) ) >> ( 64 - 23 ) );
+	}
+
+	static inline U64 packData(const ttEntry& e)
+	{
+		return packScore( e.getValue(), valueShift )
+				| packScore( e.getStaticValue(), staticValueShift )
+				| ( (U64)e.getGeneration() << generationShift )
+				| ( (U64)( e.getType() ^ typeVoid ) << typeShift );
+	}
+
+	static inline U64 packKey(const ttEntry& e)
+	{
+		return ( (U64)e.getKey() << 32 )
+				| ( (U64)e.getPackedMove() << 16 )
+				| (U64)(unsigned short)e.getDepth();
+	}
+
+	inline void write(const U64 k, const U64 d)
+	{
+		keyCheck.store( k ^ ( fold(d) << 32 ), std::memory_order_relaxed );
+		data.store( d, std::memory_order_relaxed );
+	}
+
+public:
+
+	static const unsigned int generationMask = 0xFF;
+
+	/*! \brief the part of the hash key stored in the slot*/
+	static inline unsigned int getKeyCheck(const U64 key)
+	{
+		return (unsigned int)( key >> 32 );
+	}
+
+	inline void save(const ttEntry& e)
+	{
+		write( packKey(e), packData(e) );
+	}
+
+	/*! \brief set the generation of the entry e read from the slot, if the slot still holds it*/
+	inline void refresh(const ttEntry& e, const unsigned char generation)
+	{
+		const U64 d = packData(e);
+		const U64 k = packKey(e);
+		if( keyCheck.load(std::memory_order_relaxed) == ( k ^ ( fold(d) << 32 ) )
+			&& data.load(std::memory_order_relaxed) == d )
+		{
+			write( k, ( d & ~( (U64)generationMask << generationShift ) ) | ( (U64)generation << generationShift ) );
+		}
+	}
+
+	inline ttEntry load() const
+	{
+		const U64 d = data.load(std::memory_order_relaxed);
+		const U64 k = keyCheck.load(std::memory_order_relaxed) ^ ( fold(d) << 32 );
+
+		return ttEntry( (unsigned int)( k >> 32 ),
+				unpackScore( d, valueShift ),
+				(unsigned char)( ( ( d >> typeShift ) & 0x7 ) ^ typeVoid ),
+				(signed short int)( k & 0xFFFF ),
+				(unsigned short)( ( k >> 16 ) & 0xFFFF ),
+				unpackScore( d, staticValueShift ),
+				(unsigned char)( ( d >> generationShift ) & 0xFF ) );
+	}
+
+	inline void clear()
+	{
+		keyCheck.store( 0, std::memory_order_relaxed );
+		data.store( 0, std::memory_order_relaxed );
+	}
+};
+
+static const unsigned int ttClusterSize = 4;
+typedef	std::array< ttSlot, ttClusterSize> ttCluster;
+static_assert(sizeof(ttSlot) == 16, "a slot is made of two 64 bit words");
+static_assert(sizeof(ttCluster) == 64, "a cluster should fill exactly one cache line");
+#endif
 
 
 
+
+#ifdef ENABLE_TT_STATISTICS
+/*! \brief transposition table usage counters
+	every thread updates its own instance (see local()), so no cache line is shared between searchers
+*/
+class ttStatistics
+{
+public:
+	static const unsigned int depthBuckets = 34;	/*! -2 .. 31+ plies*/
+	typedef std::atomic<unsigned long long> counter;
+
+	counter probes{0};
+	counter hits{0};
+	counter cutoffs{0};
+	counter stores{0};
+	counter emptySlotStores{0};
+	counter updates{0};
+	counter replacements{0};
+	counter sameGenerationOverwrites{0};
+	std::array<counter, depthBuckets> replacedDepth{};
+
+	static inline void increment(counter& c)
+	{
+		c.store( c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed );
+	}
+
+	static inline unsigned int getDepthBucket(signed short int depth)
+	{
+		return std::min( std::max( depth / ONE_PLY + 2, 0 ), (int)depthBuckets - 1 );
+	}
+
+	void add(const ttStatistics& other);
+	void clear();
+
+	static ttStatistics& local();
+	static void print();
+	static void reset();
+};
+#endif
+
+
+//---------------------------------------------
+//	replacement policies
+//---------------------------------------------
+/*! \brief snapshot of the entries of a cluster, as seen by the replacement policies*/
+typedef std::array<ttEntry, ttClusterSize> ttClusterEntries;
+
+/*! \brief helpers shared by the replacement policies
+	every policy exposes selectSlot(entries, keyH, depth, generation) returning the index of the slot to overwrite
+*/
+struct ttReplacementPolicyBase
+{
+	static const int notFound = -1;
+
+	/*! \brief return the first slot in [first,last) holding the same position or an empty slot*/
+	static inline int findMatchingOrEmpty(const ttClusterEntries& entries, unsigned int keyH, unsigned int first = 0, unsigned int last = ttClusterSize)
+	{
+		for(unsigned int i = first; i < last; i++)
+		{
+			if( !entries[i].getKey() || entries[i].getKey() == keyH )
+			{
+				return i;
+			}
+		}
+		return notFound;
+	}
+
+	/*! \brief number of searches elapsed since the entry has been written or refreshed*/
+	static inline unsigned int getAge(const ttEntry& e, unsigned char generation)
+	{
+		return ( generation - e.getGeneration() ) & ttSlot::generationMask;
+	}
+};
+
+/*! \brief the historical Vajolet rule: prefer old entries, then shallow non exact ones*/
+struct defaultReplacement: public ttReplacementPolicyBase
+{
+	static inline unsigned int selectSlot(const ttClusterEntries& entries, unsigned int keyH, signed short int, unsigned char generation)
+	{
+		int found = findMatchingOrEmpty(entries, keyH);
+		if( found != notFound )
+		{
+			return found;
+		}
+
+		return selectVictim(entries, generation, 0, entries.size());
+	}
+
+	/*! \brief choose the slot to overwrite in [first,last) when no empty or matching slot is available*/
+	static inline unsigned int selectVictim(const ttClusterEntries& entries, unsigned char generation, unsigned int first, unsigned int last)
+	{
+		unsigned int candidate = first;
+		for(unsigned int i = first; i < last; i++)
+		{
+			const ttEntry& c = entries[candidate];
+			const ttEntry& d = entries[i];
+			bool cc1,cc2,cc3,cc4;
+
+			cc1 = c.getGeneration() == generation;
+			cc2 = d.getGeneration() == generation;
+			cc3 = d.getType() == typeExact;
+			cc4 = d.getDepth() < c.getDepth();
+
+
+			if( (cc1 && cc4) || (!(cc2 || cc3) && (cc4 || cc1)) )
+			{
+				candidate = i;
+			}
+		}
+		return candidate;
+	}
+};
+
+/*! \brief always replace the shallowest entry, regardless of its age*/
+struct depthPreferredReplacement: public ttReplacementPolicyBase
+{
+	static inline unsigned int selectSlot(const ttClusterEntries& entries, unsigned int keyH, signed short int, unsigned char generation)
+	{
+		int found = findMatchingOrEmpty(entries, keyH);
+		if( found != notFound )
+		{
+			return found;
+		}
+
+		unsigned int candidate = 0;
+		for(unsigned int i = 1; i < entries.size(); i++)
+		{
+			const ttEntry& c = entries[candidate];
+			const ttEntry& d = entries[i];
+			if( d.getDepth() < c.getDepth() || ( d.getDepth() == c.getDepth() && getAge(d, generation) > getAge(c, generation) ) )
+			{
+				candidate = i;
+			}
+		}
+		return candidate;
+	}
+};
+
+/*! \brief replace the entry with the lowest depth, every search elapsed since the last write costs agingWeight of depth*/
+struct agingDepthReplacement: public ttReplacementPolicyBase
+{
+	static const int agingWeight = 4 * ONE_PLY;
+
+	static inline int getWorth(const ttEntry& e, unsigned char generation)
+	{
+		return e.getDepth() - agingWeight * (int)getAge(e, generation);
+	}
+
+	static inline unsigned int selectSlot(const ttClusterEntries& entries, unsigned int keyH, signed short int, unsigned char generation)
+	{
+		int found = findMatchingOrEmpty(entries, keyH);
+		if( found != notFound )
+		{
+			return found;
+		}
+
+		unsigned int candidate = 0;
+		for(unsigned int i = 1; i < entries.size(); i++)
+		{
+			if( getWorth(entries[i], generation) < getWorth(entries[candidate], generation) )
+			{
+				candidate = i;
+			}
+		}
+		return candidate;
+	}
+};
+
+/*! \brief two tier table: the first slots keep the deepest entries, the last one is always overwritten*/
+struct alwaysReplaceSecondReplacement: public ttReplacementPolicyBase
+{
+	static inline unsigned int selectSlot(const ttClusterEntries& entries, unsigned int keyH, signed short int depth, unsigned char generation)
+	{
+		const unsigned int alwaysSlot = entries.size() - 1;
+
+		int found = findMatchingOrEmpty(entries, keyH);
+		if( found != notFound )
+		{
+			return found;
+		}
+
+		// the weakest of the depth preferred slots is overwritten only by a deeper search or if it is stale
+		unsigned int candidate = 0;
+		for(unsigned int i = 1; i < alwaysSlot; i++)
+		{
+			if( entries[i].getDepth() < entries[candidate].getDepth() )
+			{
+				candidate = i;
+			}
+		}
+		if( depth >= entries[candidate].getDepth() || getAge(entries[candidate], generation) != 0 )
+		{
+			return candidate;
+		}
+		return alwaysSlot;
+	}
+};
+
+/*! \brief the first half of the cluster is reserved to the main search, the rest to the quiescence search
+	inside each half the default rule is used
+*/
+struct qsearchPartitionReplacement: public ttReplacementPolicyBase
+{
+	static inline unsigned int selectSlot(const ttClusterEntries& entries, unsigned int keyH, signed short int depth, unsigned char generation)
+	{
+		const unsigned int half = entries.size() / 2;
+		const unsigned int first = depth < 0 ? half : 0;
+		const unsigned int last = depth < 0 ? entries.size() : half;
+
+		// a position already stored is updated in place, whatever half it lives in
+		for(unsigned int i = 0; i < entries.size(); i++)
+		{
+			if( entries[i].getKey() == keyH )
+			{
+				return i;
+			}
+		}
+		int found = findMatchingOrEmpty(entries, keyH, first, last);
+		if( found != notFound )
+		{
+			return found;
+		}
+
+		return defaultReplacement::selectVictim(entries, generation, first, last);
+	}
+};
+
+/*! \brief replacement policy used by the engine, select another one at build time with
+	-DTT_REPLACEMENT_POLICY=depthPreferredReplacement (or agingDepthReplacement, alwaysReplaceSecondReplacement, qsearchPartitionReplacement)
+*/
+#ifndef TT_REPLACEMENT_POLICY
+#define TT_REPLACEMENT_POLICY defaultReplacement
+#endif
+typedef TT_REPLACEMENT_POLICY ttReplacementPolicy;
+
+
 class transpositionTable
 {
 private:
-	std::vector<ttCluster> table;
+	ttCluster* table;
 	unsigned long int elements;
 	unsigned char generation;
+	unsigned long long hugePagesBytes;	/*!< part of the table backed by huge pages*/
+
+	void freeTable();
+	void initClusters(unsigned int threads);
 
 public:
 	transpositionTable()
 	{
-		table.clear();
-		table.shrink_to_fit();
-
+		table = nullptr;
 		generation = 0;
 		elements = 1;
+		hugePagesBytes = 0;
+	}
+
+	~transpositionTable()
+	{
+		freeTable();
 	}
 
-	void newSearch() { generation++; }
-	unsigned long int setSize(unsigned long int mbSize);
+	transpositionTable(const transpositionTable&) = delete;
+	transpositionTable& operator=(const transpositionTable&) = delete;
+
+	void newSearch() { generation = ( generation + 1 ) & ttSlot::generationMask; }
+	unsigned long int setSize(unsigned long int mbSize, unsigned int threads = 1, bool useHugePages = true);
+	void clear(unsigned int threads = 1);
+	bool save(const std::string& fileName) const;
+	bool load(const std::string& fileName, unsigned int threads = 1);
+	bool isUsingHugePages() const { return hugePagesBytes > 0; }
+	unsigned long int getHugePagesMB() const { return (unsigned long int)( hugePagesBytes >> 20 ); }
+	unsigned long int getSizeMB() const { return (unsigned long int)( ( (unsigned long long int)elements * sizeof(ttCluster) ) >> 20 ); }
 
 	inline ttCluster& findCluster(U64 key)
 	{
 		return table[ static_cast<size_t>(((unsigned int)key) % elements) ];
 	}
 
-	inline void refresh(ttEntry& tte)
+	/*! \brief mark a probed entry as used by the current search
+		nothing is written if another thread has replaced the entry in the meantime
+	*/
+	inline void refresh(const ttEntry& tte)
 	{
-		tte.setGeneration(generation);
+		if( tte.slot )
+		{
+			tte.slot->refresh(tte, generation);
+		}
 	}
 
-	ttEntry* probe(const U64 key);
+	ttEntry probe(const U64 key);
+
+	/*! \brief notify that a probed entry has been used to cut the search*/
+	inline void recordCutoff()
+	{
+#ifdef ENABLE_TT_STATISTICS
+		ttStatistics::increment( ttStatistics::local().cutoffs );
+#endif
+	}
 
+	template<class ReplacementPolicy = ttReplacementPolicy>
 	void store(const U64 key, Score value, unsigned char type, signed short int depth, unsigned short move, Score statValue);
 
 	unsigned int getFullness() const
@@ -140,11 +624,11 @@ public:
 		unsigned int cnt = 0u;
 		unsigned int end = std::min( 250lu, elements );
 
-		for (auto t = table.begin(); t != table.begin()+end; t++)
+		for (unsigned int i = 0; i < end; i++)
 		{
-			cnt+= std::count_if (t->begin(), t->end(), [=](ttEntry d){return d.getGeneration() == this->generation;});
+			cnt+= std::count_if (table[i].begin(), table[i].end(), [=](const ttSlot& d){return d.load().getGeneration() == this->generation;});
 		}
-		return (unsigned int)(cnt*250lu/(end));
+		return (unsigned int)(cnt*1000lu/(end * ttClusterSize));
 	}
 
 
@@ -26,6 +26,7 @@
 #include "transposition.h"
 #include "search.h"
 #include "eval.h"
+#include "nnue.h"
 #include "syzygy/tbprobe.h"
 
 
@@ -64,6 +65,8 @@ int main()
 	TT.setSize(1);
 	Position::initMaterialKeys();
 	tb_init(Search::SyzygyPath.c_str());
+	std::string nnueError;
+	NNUE.load(nnueNetwork::defaultFileName, nnueError);	// optional, the classical evaluation is used without it
 
 	//----------------------------------
 	//	main loop
@@ -42,6 +42,9 @@
 //#define DEBUG_EVAL_SIMMETRY
 //#define DISABLE_TIME_DIPENDENT_OUTPUT
 //#define ENABLE_CHECK_CONSISTENCY
+//#define ENABLE_TT_STATISTICS
+//#define ENABLE_TT_COMPACT_ENTRIES
+//#define ENABLE_VISITED_POSITIONS
 
 
 #define MAX_MOVE_PER_POSITION (250)